@@ -0,0 +1,49 @@
+#ifndef ADAPTIVE_CONTOURS_H
+#define ADAPTIVE_CONTOURS_H
+
+#include "curvature.h"
+#include "progressive_mesh.h"
+#include <vector>
+
+// Links a coarse level of a progressive mesh to the displayed (fine) level,
+// so contour extraction can skip the fine faces under coarse regions where
+// no contour can be.  Built once per pair of levels.
+struct AdaptiveContourMap {
+	const Mesh *coarseMesh;
+	const ViewCurvatureCache *coarseCache;
+	// fine faces with a vertex that collapses into coarse vertex c are
+	// fineFaces[first[c]..first[c+1])
+	std::vector<unsigned int> first, fineFaces;
+	size_t nFineVertices, nFineFaces;
+	bool valid;
+
+	AdaptiveContourMap() : coarseMesh(0), coarseCache(0), nFineVertices(0), nFineFaces(0), valid(false) {}
+};
+
+// Work space of selectContourFaces, one per thread
+struct AdaptiveContourScratch {
+	ViewCurvatureField coarseField;
+	std::vector<unsigned char> active, grown;
+	std::vector<unsigned int> vertexStamp, faceStamp;
+	unsigned int stamp;
+	std::vector<unsigned int> vertices, faces;   // the selection
+
+	AdaptiveContourScratch() : stamp(0) {}
+};
+
+/**
+ * Builds map from the two extracted levels of progressive.
+ * @param coarseLevel vertex count of progressive when coarseMesh was extracted
+ * @param coarseIds, fineIds the vertexIds returned by ProgressiveMesh::extract
+ */
+void buildAdaptiveContourMap(const ProgressiveMesh &progressive, size_t coarseLevel, const Mesh &coarseMesh, const std::vector<unsigned int> &coarseIds, const ViewCurvatureCache &coarseCache, const std::vector<unsigned int> &fineIds, const ViewCurvatureCache &fineCache, AdaptiveContourMap &map);
+
+/**
+ * Evaluates the view curvature on the coarse level and selects the fine
+ * faces (and their vertices) near coarse faces where it changes sign or
+ * that are close to the silhouette.  The result is in scratch.faces and
+ * scratch.vertices; its size follows the contours, not the mesh.
+ */
+void selectContourFaces(const AdaptiveContourMap &map, const ViewCurvatureCache &fineCache, OpenMesh::Vec3f camPos, AdaptiveContourScratch &scratch);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef CHAINING_H
+#define CHAINING_H
+
+#include "mesh_definitions.h"
+#include "contours.h"
+#include <vector>
+
+// A set of polylines sharing one point array: polyline i is
+// points[first[i] .. first[i]+count[i]).  A closed loop repeats its first
+// point at the end.  first and count can go straight to glMultiDrawArrays.
+struct Polylines {
+	std::vector<OpenMesh::Vec3f> points;
+	std::vector<int> first, count;
+
+	size_t size() const { return first.size(); }
+	void clear() { points.clear(); first.clear(); count.clear(); }
+};
+
+/**
+ * Links contour segments that cross the same mesh edge into polylines.
+ */
+void chainContours(const ContourBuffer &contours, Polylines &polylines);
+
+/**
+ * Links edges given as vertex index pairs into polylines through the
+ * vertices they share.  Chains stop at vertices where more than two of the
+ * edges meet.
+ */
+void chainLines(const Mesh &mesh, const std::vector<unsigned int> &lines, Polylines &polylines);
+
+#endif
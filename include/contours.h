@@ -0,0 +1,40 @@
+#ifndef CONTOURS_H
+#define CONTOURS_H
+
+#include "mesh_definitions.h"
+#include "curvature.h"
+#include <vector>
+
+// One piece of suggestive contour, clipped to a single face.  Each end lies on
+// a mesh edge, which is what links it to the segment in the neighbouring face.
+struct ContourSegment {
+	OpenMesh::Vec3f p0, p1;
+	unsigned int e0, e1;    // edge indices under p0 and p1
+};
+
+// Output of extractSuggestiveContours.  Every face yields at most one
+// segment, so the buffer keeps one slot per face and is reused from one
+// extraction to the next without reallocating; only [0,size) is valid.
+struct ContourBuffer {
+	std::vector<ContourSegment> segments;
+	size_t size;
+
+	ContourBuffer() : size(0) {}
+	const ContourSegment& operator[](size_t i) const { return segments[i]; }
+};
+
+/**
+ * Finds the zero crossings of the view curvature on every face that passes
+ * the angle and derivative tests and stores one segment per such face, in
+ * face order.  Faces are processed in parallel chunks.  Makes no GL calls,
+ * so it can be run and timed without a window.
+ */
+void extractSuggestiveContours(const Mesh &mesh, const ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, const ViewCurvatureField &field, double angleThresh, double gradThresh, ContourBuffer &contours);
+
+/**
+ * Same, but only looks at the listed faces and stores segments in list
+ * order.  field only needs to be valid on those faces and their vertices.
+ */
+void extractSuggestiveContours(const Mesh &mesh, const ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, const ViewCurvatureField &field, double angleThresh, double gradThresh, const std::vector<unsigned int> &faces, ContourBuffer &contours);
+
+#endif
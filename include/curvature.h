@@ -2,13 +2,59 @@
 #define CURVATURE_H
 
 #include "mesh_definitions.h"
+#include <vector>
 
 struct CurvatureInfo {
 	OpenMesh::Vec3f directions[2];
 	double curvatures[2];
 };
 
+// View-independent terms of the view curvature, gathered once after
+// computeCurvature.  For a vertex p with principal frame (T1,T2) the view
+// vector projects to (camPos.T1 - p.T1, camPos.T2 - p.T2), so a camera move
+// only changes the camPos dot products; everything else is cached here.
+// Per-vertex terms are kept as separate packed float arrays (one array per
+// component) so evaluateViewCurvature can stream them 8 vertices at a time.
+struct ViewCurvatureCache {
+	std::vector<float> t1[3], t2[3];          // principal directions per vertex
+	std::vector<float> k1, k2;                // principal curvatures per vertex
+	std::vector<float> pT1, pT2;              // point dotted with T1 and T2
+	std::vector<unsigned int> faceVertices;   // three vertex indices per face
+	std::vector<unsigned int> faceEdges;      // three edge indices per face, edge i joins vertices i and i+1
+	std::vector<OpenMesh::Vec3f> faceGrad;    // two per face: gradients of the hat functions of vertices 1 and 2
+	OpenMesh::Vec3f lastCamPos;
+	bool valid, upToDate;
+
+	ViewCurvatureCache() : valid(false), upToDate(false) {}
+	// mark the cache stale, e.g. after the mesh geometry changed
+	void invalidate() { valid = upToDate = false; }
+};
+
+// View-dependent values for one camera, indexed by vertex/face index.  The
+// projected view vector w is stored one array per component.
+struct ViewCurvatureField {
+	std::vector<float> viewCurvature;                     // per vertex
+	std::vector<float> viewVecProjection[3];              // per vertex
+	std::vector<OpenMesh::Vec3f> viewCurvatureDerivative; // per face
+
+	void resize(size_t nVertices, size_t nFaces);
+	OpenMesh::Vec3f w(size_t i) const {
+		return OpenMesh::Vec3f(viewVecProjection[0][i],viewVecProjection[1][i],viewVecProjection[2][i]);
+	}
+};
+
 void computeCurvature(Mesh &mesh, OpenMesh::VPropHandleT<CurvatureInfo> &curvature);
-void computeViewCurvature(Mesh &mesh, OpenMesh::Vec3f camPos, OpenMesh::VPropHandleT<CurvatureInfo> &curvature, OpenMesh::VPropHandleT<double> &viewCurvature, OpenMesh::FPropHandleT<OpenMesh::Vec3f> &viewCurvatureDerivative, OpenMesh::VPropHandleT<OpenMesh::Vec3f> &viewVecProjection);
+
+void buildViewCurvatureCache(Mesh &mesh, OpenMesh::VPropHandleT<CurvatureInfo> &curvature, ViewCurvatureCache &cache);
+// Computes view curvature, its per-face gradient and the projected view
+// vectors for camPos from the cache.  Only reads the cache, so several
+// threads may evaluate different cameras.  Uses AVX2 when compiled for it.
+void evaluateViewCurvature(const ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, ViewCurvatureField &field);
+// Same, but only for the listed vertices and faces; the faces must only use
+// listed vertices.  Entries of field outside the lists are left as they were.
+void evaluateViewCurvature(const ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, const std::vector<unsigned int> &vertices, const std::vector<unsigned int> &faces, ViewCurvatureField &field);
+// Same as evaluateViewCurvature, but returns false without touching field if
+// the camera has not moved since the last call.
+bool updateViewCurvature(ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, ViewCurvatureField &field);
 
 #endif
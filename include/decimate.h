@@ -1,10 +1,17 @@
+#ifndef DECIMATE_HH
 #define DECIMATE_HH
 
 //== INCLUDES =================================================================
 
+#include <cmath>
 #include "mesh_definitions.h"
+#include "indexed_heap.h"
 
-void simplify(Mesh &mesh, float percentage);
+/**
+ * Simplifies mesh to the given fraction of its vertices.  Shorthand for
+ * Decimator(mesh).simplify(percentage, parallel).
+ */
+void simplify(Mesh &mesh, float percentage, bool parallel = false);
 
 //== CLASS DEFINITION =========================================================
 
@@ -74,6 +81,39 @@ public:
 				+ 2.0 * i * z + j;
 	}
 
+	/// evaluate quadric at _n points at once: _out[k] = _v[k]*Q*_v[k].
+	/// Coefficients are doubled once up front and the loop is branch free,
+	/// so the compiler vectorizes it.
+	template<typename T>
+	void evaluate(const OpenMesh::VectorT<T, 3> *_v, size_t _n, Scalar *_out) const {
+		const Scalar b2 = 2 * b, c2 = 2 * c, d2 = 2 * d;
+		const Scalar f2 = 2 * f, g2 = 2 * g, i2 = 2 * i;
+		for (size_t k = 0; k < _n; k++) {
+			Scalar x(_v[k][0]), y(_v[k][1]), z(_v[k][2]);
+			_out[k] = x * (a * x + b2 * y + c2 * z + d2) + y * (e * y + f2 * z + g2)
+					+ z * (h * z + i2) + j;
+		}
+	}
+
+	/// point minimizing the quadric, i.e. the solution of the upper-left
+	/// 3x3 block times x = -(d,g,i).  Returns false and leaves _v alone
+	/// if that block is (nearly) singular, e.g. for flat or linear regions.
+	template<typename T>
+	bool minimizer(OpenMesh::VectorT<T, 3>& _v) const {
+		// cofactors of the symmetric block [a b c; b e f; c f h]
+		Scalar c00 = e * h - f * f, c01 = c * f - b * h, c02 = b * f - c * e;
+		Scalar c11 = a * h - c * c, c12 = b * c - a * f, c22 = a * e - b * b;
+		Scalar det = a * c00 + b * c01 + c * c02;
+		Scalar trace = a + e + h;
+		if (std::fabs(det) <= 1e-8 * trace * trace * trace || det == 0.0)
+			return false;
+		Scalar s = -1.0 / det;
+		_v[0] = T(s * (c00 * d + c01 * g + c02 * i));
+		_v[1] = T(s * (c01 * d + c11 * g + c12 * i));
+		_v[2] = T(s * (c02 * d + c12 * g + c22 * i));
+		return true;
+	}
+
 private:
 
 	Scalar a, b, c, d, e, f, g, h, i, j;
@@ -84,3 +124,86 @@ typedef QuadricT<float> Quadricf;
 
 /// Quadric using double
 typedef QuadricT<double> Quadricd;
+
+/// one edge collapse as performed by Decimator, in the handles of the
+/// mesh before garbage collection
+struct CollapseRecord {
+	int from, to;              // from is removed, to survives
+	Mesh::Point position;      // new position of to
+};
+
+//== CLASS DEFINITION =========================================================
+
+/** /class Decimator
+
+ Quadric error edge-collapse simplification of one mesh.  All state (the
+ per-vertex properties, the priority queue and scratch space) lives in
+ the object, so separate meshes can be simplified concurrently, one
+ Decimator per thread.
+ **/
+
+class Decimator {
+public:
+	/// adds the decimation properties to mesh; removed again on destruction
+	Decimator(Mesh &mesh);
+	~Decimator();
+
+	/// collapses edges until percentage of the vertices are left, using
+	/// decimateParallel() instead of decimate() if parallel is set
+	void simplify(float percentage, bool parallel = false);
+
+	/// collapses edges until at most nVertices are left
+	void decimate(unsigned int nVertices);
+
+	/**
+	 * Like decimate(), but in rounds: each round picks a set of cheap
+	 * collapses whose one-rings do not touch and applies them on all
+	 * threads.  Slightly worse than the strict greedy order, much faster
+	 * on large meshes.
+	 */
+	void decimateParallel(unsigned int nVertices);
+
+	/// appends every collapse made from now on to records (0 to stop)
+	void recordCollapses(std::vector<CollapseRecord> *records) { records_ = records; }
+
+private:
+	Decimator(const Decimator&);
+	Decimator& operator=(const Decimator&);
+
+	void initQuadrics();
+	bool isCollapseOk(Mesh::HalfedgeHandle hh);
+	bool isCollapseLegal(Mesh::HalfedgeHandle hh);
+	float priority(Mesh::HalfedgeHandle hh);
+	void invalidateEdges();
+	void invalidateEdges(Mesh::VertexHandle vh);
+	void updateEdge(Mesh::EdgeHandle eh);
+	float edgeCost(Mesh::EdgeHandle eh);
+	const Mesh::Point& edgePosition(Mesh::EdgeHandle eh);
+	CollapseRecord collapse(Mesh::HalfedgeHandle hh);
+	Mesh::HalfedgeHandle bestCollapse(Mesh::VertexHandle vh, float &cost);
+	void enqueueVertex(Mesh::VertexHandle vh);
+
+	Quadricd& quadric(Mesh::VertexHandle vh) { return mesh_.property(vquadric_, vh); }
+	Mesh::HalfedgeHandle& target(Mesh::VertexHandle vh) { return mesh_.property(vtarget_, vh); }
+
+	Mesh &mesh_;
+	OpenMesh::VPropHandleT<Quadricd> vquadric_;
+	OpenMesh::VPropHandleT<Mesh::HalfedgeHandle> vtarget_;
+
+	// collapse cost and surviving vertex position per edge; a negative
+	// cost marks the entry as stale
+	OpenMesh::EPropHandleT<float> ecost_;
+	OpenMesh::EPropHandleT<Mesh::Point> eposition_;
+
+	// candidate vertices keyed by the cost of their best collapse
+	IndexedHeap<float> queue_;
+
+	// scratch for decimateParallel
+	std::vector<float> cost_;
+	std::vector<unsigned int> candidates_;
+	std::vector<unsigned char> marked_;
+
+	std::vector<CollapseRecord> *records_;
+};
+
+#endif
@@ -2,9 +2,60 @@
 #define IMAGE_GENERATION_H
 
 #include "mesh_definitions.h"
+#include "chaining.h"
+#include <vector>
 #include <string>
 
-bool isVisible(OpenMesh::Vec3f point);
-void writeImage(Mesh &mesh, int width, int height, std::string filename, OpenMesh::Vec3f camPos);
+// Camera of the current GL context, fetched once per image
+struct ScreenProjection {
+	double matrix[16];   // projection * modelview, column-major like GL
+	int viewport[4];
+};
+
+// Depth buffer of the viewport, read back in one call
+struct DepthImage {
+	int x, y, width, height;
+	std::vector<float> depth;   // row-major, bottom row first
+};
+
+void getScreenProjection(ScreenProjection &projection);
+void readDepthImage(const ScreenProjection &projection, DepthImage &image);
+
+/**
+ * Projects n points to window coordinates like gluProject: x and y in
+ * pixels, z the depth in [0,1].  Points behind the camera get z = -1.
+ */
+void projectPoints(const ScreenProjection &projection, const OpenMesh::Vec3f *points, size_t n, OpenMesh::Vec3f *projected);
+
+/**
+ * Returns true if a projected point is at most tolerance behind the depth
+ * image.  Points outside the image are not covered by anything and count
+ * as visible.
+ */
+bool isVisible(const DepthImage &image, const OpenMesh::Vec3f &projected, float tolerance);
+
+// Min/max mip chain of a depth image.  Texel (x,y) of level k >= 1 bounds
+// the depths of the 2^k x 2^k pixels of the image it covers.
+struct DepthPyramid {
+	const DepthImage *image;   // level 0
+	std::vector<int> width, height;
+	std::vector< std::vector<float> > minDepth, maxDepth;   // levels 1..
+};
+
+void buildDepthPyramid(const DepthImage &image, DepthPyramid &pyramid);
+
+/**
+ * Appends the visible parts of the projected segment a-b to intervals, as
+ * ranges [t0,t1] of the parameter of a + t(b-a) in increasing order.
+ * Spans that the pyramid shows to be entirely in front of or behind the
+ * surface are resolved at once; only spans crossing a depth discontinuity
+ * are subdivided, down to a pixel.
+ */
+void visibleIntervals(const DepthPyramid &pyramid, const OpenMesh::Vec3f &a, const OpenMesh::Vec3f &b, std::vector< std::pair<float,float> > &intervals);
+
+// Writes the visible parts of each set of polylines to an SVG file
+void writeImage(int width, int height, std::string filename, const ScreenProjection &projection, const DepthImage &depth, const std::vector<const Polylines*> &lines);
+// Same, with the camera and depth buffer of the current GL context
+void writeImage(Mesh &mesh, int width, int height, std::string filename, OpenMesh::Vec3f camPos, const std::vector<const Polylines*> &lines);
 
 #endif
@@ -0,0 +1,126 @@
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * Min-heap over the integers [0,n) with a key per element.  Every element
+ * remembers its slot in the heap, so changing or removing the key of an
+ * element is done in place in O(log n) without searching for it.  Equal
+ * keys are ordered by element index, which keeps pops deterministic.
+ * The heap is D-ary (4 by default): shallower than a binary heap and the
+ * children of a node share a cache line.
+ */
+template<class Key, int D = 4>
+class IndexedHeap {
+public:
+	IndexedHeap() {}
+
+	/**
+	 * Empties the heap and makes room for elements 0..n-1.
+	 */
+	void reset(size_t n) {
+		heap_.clear();
+		heap_.reserve(n);
+		keys_.assign(n, Key());
+		pos_.assign(n, -1);
+	}
+
+	bool empty() const { return heap_.empty(); }
+	size_t size() const { return heap_.size(); }
+	bool contains(int i) const { return pos_[i] >= 0; }
+	const Key& key(int i) const { return keys_[i]; }
+
+	/// element with the smallest key; the heap must not be empty
+	int top() const { return heap_[0]; }
+
+	/// removes and returns the element with the smallest key
+	int pop() {
+		int i = heap_[0];
+		remove(i);
+		return i;
+	}
+
+	/**
+	 * Inserts element i with the given key, or moves it if it is already
+	 * in the heap.
+	 */
+	void update(int i, Key k) {
+		int p = pos_[i];
+		if (p < 0) {
+			keys_[i] = k;
+			pos_[i] = (int)heap_.size();
+			heap_.push_back(i);
+			siftUp(pos_[i]);
+		} else if (k < keys_[i]) {
+			keys_[i] = k;
+			siftUp(p);
+		} else {
+			keys_[i] = k;
+			siftDown(p);
+		}
+	}
+
+	/// removes element i if it is in the heap
+	void remove(int i) {
+		int p = pos_[i];
+		if (p < 0) return;
+		pos_[i] = -1;
+		int last = heap_.back();
+		heap_.pop_back();
+		if (last == i) return;
+		heap_[p] = last;
+		pos_[last] = p;
+		siftUp(p);
+		siftDown(pos_[last]);
+	}
+
+	void clear() {
+		for (size_t k = 0; k < heap_.size(); k++) pos_[heap_[k]] = -1;
+		heap_.clear();
+	}
+
+private:
+	bool less(int i, int j) const {
+		return keys_[i] < keys_[j] || (!(keys_[j] < keys_[i]) && i < j);
+	}
+
+	void siftUp(int p) {
+		int i = heap_[p];
+		while (p > 0) {
+			int parent = (p - 1) / D;
+			if (!less(i, heap_[parent])) break;
+			heap_[p] = heap_[parent];
+			pos_[heap_[p]] = p;
+			p = parent;
+		}
+		heap_[p] = i;
+		pos_[i] = p;
+	}
+
+	void siftDown(int p) {
+		int i = heap_[p];
+		int n = (int)heap_.size();
+		for (;;) {
+			int first = p*D + 1;
+			if (first >= n) break;
+			int last = first + D < n ? first + D : n;
+			int best = first;
+			for (int c = first + 1; c < last; c++)
+				if (less(heap_[c], heap_[best])) best = c;
+			if (!less(heap_[best], i)) break;
+			heap_[p] = heap_[best];
+			pos_[heap_[p]] = p;
+			p = best;
+		}
+		heap_[p] = i;
+		pos_[i] = p;
+	}
+
+	std::vector<int> heap_;  // heap order -> element
+	std::vector<int> pos_;   // element -> heap slot, -1 if absent
+	std::vector<Key> keys_;
+};
+
+#endif
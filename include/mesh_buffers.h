@@ -0,0 +1,61 @@
+#ifndef MESH_BUFFERS_H
+#define MESH_BUFFERS_H
+
+#include <GLUT/glut.h>
+#include "mesh_definitions.h"
+
+class MeshBuffers {
+public:
+	/**
+	 * Keeps the triangle indices, vertex positions and vertex normals of a
+	 * mesh in GL buffer objects.  Nothing is uploaded until update() is
+	 * called, which needs a current GL context.  Only core OpenGL 1.5 calls
+	 * are used, so this also works with software implementations.
+	 */
+	MeshBuffers();
+	
+	/**
+	 * This function deletes the buffer objects.
+	 */
+	~MeshBuffers();
+	
+	/**
+	 * Uploads the mesh if it changed since the last upload (see
+	 * invalidate()), otherwise does nothing.
+	 * @param mesh the mesh to upload
+	 */
+	void update(const Mesh& mesh);
+	
+	/**
+	 * Marks the uploaded data as stale.  Call this whenever the mesh
+	 * geometry or connectivity changes, e.g. after simplification.
+	 */
+	void invalidate();
+	
+	/**
+	 * Sets up the fixed-function vertex (and optionally normal) arrays and
+	 * the index buffer for draw().  Undo with unbind() before drawing from
+	 * client memory again.
+	 * @param normals whether to enable the normal array
+	 */
+	void bind(bool normals) const;
+	void unbind() const;
+	
+	/**
+	 * Draws all triangles from the bound buffers.
+	 */
+	void draw() const;
+	
+	GLuint positionBuffer() const;
+	GLuint normalBuffer() const;
+	GLuint indexBuffer() const;
+	
+private:
+	GLuint positionBuffer_;
+	GLuint normalBuffer_;
+	GLuint indexBuffer_;
+	GLsizei indexCount_;
+	bool dirty_;
+};
+
+#endif
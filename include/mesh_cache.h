@@ -0,0 +1,81 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mesh_definitions.h"
+#include "curvature.h"
+#include "progressive_mesh.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// What a cache file was built from; a cache is only used if all fields match
+struct MeshCacheKey {
+	uint64_t fileHash;       // FNV-1a of the input mesh file
+	float baseFraction;      // decimation ratio of the progressive mesh
+	uint32_t parallel;       // whether the decimation ran in parallel rounds
+
+	MeshCacheKey() : fileHash(0), baseFraction(0), parallel(0) {}
+};
+
+// A level of a progressive mesh extracted into a Mesh, with its normals and
+// curvature
+struct MeshCacheLevel {
+	size_t level;    // vertex count of the progressive mesh when extracted
+	Mesh *mesh;
+	OpenMesh::VPropHandleT<CurvatureInfo> *curvature;
+};
+
+/**
+ * Hashes the contents of filename with 64 bit FNV-1a.  Returns false if the
+ * file cannot be read.
+ */
+bool hashFile(const std::string &filename, uint64_t &hash);
+
+/**
+ * Writes the normalized progressive mesh and the normals and curvature of
+ * the given levels to filename.  Every section is a contiguous array at an
+ * aligned offset, so a reader can use the mapped file as is.  progressive
+ * is taken to full resolution while writing and then restored.
+ */
+bool writeMeshCache(const std::string &filename, const MeshCacheKey &key, ProgressiveMesh &progressive, const std::vector<MeshCacheLevel> &levels);
+
+/**
+ * A cache file mapped into memory.  Loading only copies the mapped arrays
+ * into their destinations.
+ */
+class MeshCache {
+public:
+	MeshCache();
+	~MeshCache();
+
+	// Maps filename; false if it is missing, damaged or built for another key
+	bool open(const std::string &filename, const MeshCacheKey &key);
+	void close();
+	bool isOpen() const;
+
+	void loadProgressive(ProgressiveMesh &progressive) const;
+
+	/**
+	 * Sets the normals and curvature of mesh, extracted at the given
+	 * level.  Returns false, leaving mesh alone, if that level is not in
+	 * the cache.
+	 */
+	bool loadLevel(size_t level, Mesh &mesh, OpenMesh::VPropHandleT<CurvatureInfo> &curvature) const;
+
+private:
+	struct Level {
+		size_t level, nVertices, nFaces;
+		const OpenMesh::Vec3f *vertexNormals, *faceNormals;
+		const CurvatureInfo *curvature;
+	};
+
+	void *data_;
+	size_t size_;
+	const Mesh::Point *points_;
+	const unsigned int *indices_, *corners_, *faceCount_;
+	const VertexSplit *splits_;
+	size_t nPoints_, nFaces_, nSplits_, nCorners_;
+	std::vector<Level> levels_;
+};
+
+#endif
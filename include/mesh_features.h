@@ -2,9 +2,46 @@
 #define MESH_FEATURES_H
 
 #include "mesh_definitions.h"
+#include "chaining.h"
+#include <vector>
+
+// Default dihedral angle (degrees between face normals) above which an edge is sharp
+#define DEFAULT_SHARP_ANGLE 60.0f
+
+// Node of the silhouette hierarchy.  Bounds the midpoints of its edges with
+// a box and the normals of their faces with a cone, so a whole subtree can
+// be skipped when every one of those faces faces the same way.
+struct SilhouetteNode {
+	OpenMesh::Vec3f boxMin, boxMax;
+	OpenMesh::Vec3f coneAxis;
+	float coneAngle;              // half angle in radians, >= pi/2 when the normals can't be bounded
+	unsigned int first, count;    // edge range of a leaf in FeatureEdgeCache::silhouetteCandidates
+	int children[2];              // child node indices, -1 for a leaf
+};
+
+// Feature edges that do not depend on the view, classified once per mesh.
+// Only the silhouette test is left to do per frame, and only on the
+// remaining interior edges.
+struct FeatureEdgeCache {
+	std::vector<unsigned int> staticLines;                // vertex index pairs of boundary and sharp edges
+	Polylines staticPolylines;                            // the same edges chained into polylines
+	std::vector<Mesh::EdgeHandle> silhouetteCandidates;   // every other edge, in hierarchy order
+	std::vector<SilhouetteNode> silhouetteTree;           // root is node 0
+	float sharpAngle;                                     // threshold used for the sharp test, in degrees
+	bool valid;
+
+	FeatureEdgeCache() : sharpAngle(DEFAULT_SHARP_ANGLE), valid(false) {}
+	// mark the cache stale, e.g. after the mesh connectivity changed
+	void invalidate() { valid = false; }
+};
 
 bool isSilhouette(Mesh &mesh, const Mesh::EdgeHandle &e, OpenMesh::Vec3f cameraPos);
-bool isSharpEdge(Mesh &mesh, const Mesh::EdgeHandle &e);
+bool isSharpEdge(Mesh &mesh, const Mesh::EdgeHandle &e, float sharpAngle = DEFAULT_SHARP_ANGLE);
 bool isFeatureEdge(Mesh &mesh, const Mesh::EdgeHandle &e, OpenMesh::Vec3f cameraPos);
 
+void buildFeatureEdgeCache(Mesh &mesh, FeatureEdgeCache &cache);
+// Appends the silhouette edges among the cache's candidates as vertex index
+// pairs, skipping the parts of the hierarchy that can't contain any
+void findSilhouettes(Mesh &mesh, const FeatureEdgeCache &cache, OpenMesh::Vec3f cameraPos, std::vector<unsigned int> &lines);
+
 #endif
@@ -0,0 +1,46 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// Body of a parallel loop: called once per chunk with the half-open range
+// [begin,end) it owns and the index of the chunk (0..parallelChunks()-1).
+typedef std::function<void(size_t begin, size_t end, int chunk)> ParallelBody;
+
+/**
+ * Sets the number of threads used by parallelFor.  A value of 0 (the
+ * default) uses one thread per hardware core, 1 makes everything serial.
+ */
+void setNumThreads(int n);
+
+/**
+ * Returns the number of threads parallelFor will use.
+ */
+int numThreads();
+
+/**
+ * Returns the number of chunks parallelFor will split a range of count
+ * items into, so callers can preallocate one scratch slot per chunk.
+ */
+int parallelChunks(size_t count, size_t minChunk = 1024);
+
+/**
+ * Splits [begin,end) into contiguous chunks of at least minChunk items and
+ * runs body on each chunk in its own thread.  Chunk boundaries depend only
+ * on the range and the thread count, so a body that writes each item from
+ * that item alone produces the same result serially and in parallel.
+ * Calls made from inside a parallel body run serially on the calling thread.
+ */
+void parallelFor(size_t begin, size_t end, const ParallelBody &body, size_t minChunk = 1024);
+
+/**
+ * Like parallelFor, but for items of very different cost: each thread takes
+ * the next grain items from a shared counter until the range is done.  The
+ * chunk argument of body is the index of the thread, one of
+ * 0..parallelChunks(end-begin, grain)-1, so results must not depend on
+ * which thread runs an item.
+ */
+void parallelForDynamic(size_t begin, size_t end, const ParallelBody &body, size_t grain = 1);
+
+#endif
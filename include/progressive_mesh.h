@@ -0,0 +1,91 @@
+#ifndef PROGRESSIVE_MESH_H
+#define PROGRESSIVE_MESH_H
+
+#include "mesh_definitions.h"
+#include <vector>
+
+// Inverse of one recorded edge collapse
+struct VertexSplit {
+	unsigned int from, to;           // from reappears, splitting off to
+	Mesh::Point toFine, toCoarse;    // position of to after and before the split
+	unsigned int firstCorner, nCorners; // range in the corner list: face corners that point to from
+};
+
+/**
+ * A mesh together with the collapse sequence of its decimation, stored as
+ * flat index arrays.  Faces are ordered so that the faces alive at any
+ * level are a prefix of the index array, and each split lists the face
+ * corners it changes, so moving between levels costs time proportional to
+ * the number of splits applied or undone, not to the mesh size.
+ */
+class ProgressiveMesh {
+public:
+	ProgressiveMesh();
+
+	/**
+	 * Records the decimation of mesh down to basePercentage of its
+	 * vertices.  mesh itself is not modified.  Afterwards the progressive
+	 * mesh is at full resolution.
+	 * @param parallel whether to use Decimator::decimateParallel
+	 */
+	void build(const Mesh &mesh, float basePercentage, bool parallel = false);
+
+	/// vertex count at full resolution and at the coarsest level
+	size_t maxVertices() const;
+	size_t minVertices() const;
+
+	/// vertex count at the current level
+	size_t numVertices() const;
+
+	/**
+	 * Collapses or splits until n vertices are left (clamped to
+	 * [minVertices(), maxVertices()]).
+	 */
+	void setNumVertices(size_t n);
+
+	/// number of faces at the current level; they are the first
+	/// 3*numFaces() entries of indices()
+	size_t numFaces() const;
+	const std::vector<unsigned int>& indices() const;
+
+	/// vertex positions, indexed like the input mesh
+	const std::vector<Mesh::Point>& points() const;
+
+	/**
+	 * Replaces the contents of mesh with the current level, dropping the
+	 * vertices that are collapsed away.  Normals are not computed.
+	 * @param vertexIds if given, receives the index in points() of every
+	 *        vertex of mesh
+	 */
+	void extract(Mesh &mesh, std::vector<unsigned int> *vertexIds = 0) const;
+
+	/**
+	 * For every vertex of the full-resolution mesh, finds the vertex it is
+	 * merged into once only n vertices are left (itself if it survives).
+	 */
+	void ancestors(size_t n, std::vector<unsigned int> &ancestor) const;
+
+	/// the recorded collapses, for saving; points() and indices() hold the
+	/// rest of the state when the mesh is at full resolution
+	const std::vector<VertexSplit>& splits() const;
+	const std::vector<unsigned int>& corners() const;
+	const std::vector<unsigned int>& faceCounts() const;
+
+	/**
+	 * Restores a state saved from the accessors at full resolution.
+	 * faceCount has nSplits+1 entries.
+	 */
+	void assign(const Mesh::Point *points, size_t nPoints, const unsigned int *indices, size_t nFaces,
+				const VertexSplit *splits, size_t nSplits, const unsigned int *corners, size_t nCorners,
+				const unsigned int *faceCount);
+
+private:
+	std::vector<Mesh::Point> points_;
+	std::vector<unsigned int> indices_;
+	std::vector<VertexSplit> splits_;      // in collapse order
+	std::vector<unsigned int> corners_;
+	std::vector<unsigned int> faceCount_;  // live faces after i collapses
+	size_t collapsed_;                     // number of collapses applied
+};
+
+#endif
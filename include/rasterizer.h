@@ -0,0 +1,40 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "mesh_definitions.h"
+#include "image_generation.h"
+#include <vector>
+
+// Perspective camera with the conventions of gluPerspective and gluLookAt,
+// looking at a viewport of width x height pixels at the origin
+struct Camera {
+	OpenMesh::Vec3f eye, center, up;
+	float fovy;            // vertical field of view in degrees
+	float zNear, zFar;
+	int width, height;
+
+	// the viewer's default camera
+	Camera() : eye(0,0,4), center(0,0,0), up(0,1,0), fovy(50), zNear(0.5f), zFar(1000), width(640), height(480) {}
+};
+
+/**
+ * Computes the projection the viewer would set up in GL for camera.
+ */
+void cameraProjection(const Camera &camera, ScreenProjection &projection);
+
+/**
+ * Renders the depth of the triangles into image on the CPU, with the same
+ * window depth values GL would produce for projection.  The viewport is
+ * split into tiles that are rasterized in parallel, 8 pixels at a time
+ * with AVX2.  Triangles that reach behind the near plane or beyond the far
+ * plane are skipped rather than clipped.
+ * @param triangles three indices into points per triangle
+ */
+void rasterizeDepth(const OpenMesh::Vec3f *points, size_t nPoints, const std::vector<unsigned int> &triangles, const ScreenProjection &projection, DepthImage &image);
+
+/**
+ * Same, for all faces of mesh.
+ */
+void rasterizeDepth(const Mesh &mesh, const ScreenProjection &projection, DepthImage &image);
+
+#endif
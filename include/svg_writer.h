@@ -0,0 +1,47 @@
+#ifndef SVG_WRITER_H
+#define SVG_WRITER_H
+
+#include "mesh_definitions.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Streams an SVG line drawing to a file through one large buffer.
+ * Polylines become subpaths of <path> elements in relative coordinates,
+ * with every coordinate rounded to 1/100 of a pixel.  Deltas are taken
+ * between rounded positions, so rounding errors do not accumulate.
+ */
+class SvgWriter {
+public:
+	SvgWriter();
+	~SvgWriter();
+
+	// Creates filename and writes the document header; false on failure
+	bool open(const std::string &filename, int width, int height);
+
+	// Polylines between beginPath and endPath share one <path> element
+	void beginPath();
+	void endPath();
+
+	// Adds points[0..n) as a subpath, flipping y from window coordinates
+	void polyline(const OpenMesh::Vec3f *points, size_t n);
+
+	// Writes the document footer and closes the file
+	void close();
+
+private:
+	void reserve(size_t n);
+	void flush();
+	void put(const char *s);
+	void putFixed(long long hundredths, bool separate);
+
+	FILE *file_;
+	std::vector<char> buffer_;
+	size_t used_;
+	int height_;
+	bool inPath_;
+	long long lastX_, lastY_;   // current point, in 1/100 pixel
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef TAM_ATLAS_H
+#define TAM_ATLAS_H
+
+#include <string>
+#include <vector>
+
+// Number of tones of the tonal art map and of resolutions per tone
+#define TAM_TONES 6
+#define TAM_LEVELS 4
+
+// Tonal art map ready for upload: tones 0-2 and 3-5 in the RGB channels of
+// two RGBA textures.  Level l of each texture is the TAM image of edge
+// size >> l, so the mip chain is the TAM's own, not a filtered copy.
+struct TamAtlas {
+	int size;     // edge of level 0
+	int levels;
+	std::vector<unsigned char> pixels;   // texture 0 levels 0..levels-1, then texture 1
+
+	TamAtlas() : size(0), levels(0) {}
+	// RGBA pixels of one level, rows in the order of the source images
+	const unsigned char* level(int texture, int l) const;
+	unsigned char* level(int texture, int l);
+};
+
+/**
+ * Builds the atlas from the images tam<tone><resolution>.bmp in directory,
+ * where resolution TAM_LEVELS-1 is the largest.  Returns false if an image
+ * is missing or has the wrong size.
+ */
+bool packTamAtlas(const std::string &directory, TamAtlas &atlas);
+
+// Binary atlas files, read with a single read
+bool writeTamAtlas(const std::string &filename, const TamAtlas &atlas);
+bool readTamAtlas(const std::string &filename, TamAtlas &atlas);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TAM_GENERATOR_H
+#define TAM_GENERATOR_H
+
+#include "tam_atlas.h"
+
+// Stroke parameters of a generated tonal art map
+struct TamParameters {
+	int size;                 // edge of the largest level; level l is size >> l
+	float tones[TAM_TONES];   // darkness each tone is filled to, increasing
+	int crossTone;            // tones from this one on add strokes across the first ones
+	float strokeWidth;        // in pixels, the same at every level
+	float minLength, maxLength; // stroke length as a fraction of the texture
+	float angleJitter;        // largest deviation from the hatching direction, radians
+	int candidates;           // random strokes tried for each stroke placed
+	unsigned int seed;
+
+	TamParameters();
+};
+
+/**
+ * Generates a nested tonal art map in the style of Praun et al.: tones are
+ * filled from light to dark and levels from coarse to fine, and a stroke
+ * placed in one image also appears in every darker tone and finer level.
+ * Each stroke is the best of a set of random candidates, scored in parallel
+ * by how much new tone it adds across the levels it lands on relative to
+ * its own ink, so strokes spread out instead of piling up.  The darkness of
+ * every level is tracked incrementally, so a candidate costs only its own
+ * footprint.
+ */
+void generateTam(const TamParameters &parameters, TamAtlas &atlas);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef VIEW_WORKER_H
+#define VIEW_WORKER_H
+
+#include "curvature.h"
+#include "contours.h"
+#include "chaining.h"
+#include "adaptive_contours.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything that depends on the camera, computed for one camera position
+struct ViewState {
+	OpenMesh::Vec3f camPos;
+	ViewCurvatureField field;
+	ContourBuffer contours;
+	Polylines contourLines;   // contours chained across faces
+};
+
+// Camera and thresholds a ViewState is computed for
+struct ViewRequest {
+	OpenMesh::Vec3f camPos;
+	double angleThresh, gradThresh;
+	bool adaptive;   // only look at faces selected through the adaptive map
+
+	ViewRequest() : angleThresh(0), gradThresh(0), adaptive(false) {}
+};
+
+/**
+ * Computes view curvature and suggestive contours for request.camPos into
+ * state, and chains the contours into polylines.  If request.adaptive is
+ * set and adaptive is a valid map, only the faces it selects are used.
+ */
+void computeViewState(const Mesh &mesh, const ViewCurvatureCache &cache, const ViewRequest &request, ViewState &state,
+					  const AdaptiveContourMap *adaptive = 0, AdaptiveContourScratch *scratch = 0);
+
+/**
+ * Recomputes the view-dependent state on a background thread so the GLUT
+ * event thread never waits for it.  Only the newest request is kept: a
+ * request made while the worker is busy replaces any request that has not
+ * started yet.  Results are handed over through a swap of buffers, so the
+ * worker fills one buffer while display() draws another.
+ *
+ * The mesh and cache must not change while the worker is running.
+ */
+class ViewWorker {
+public:
+	ViewWorker(const Mesh &mesh, const ViewCurvatureCache &cache);
+	
+	/**
+	 * Stops the worker thread.
+	 */
+	~ViewWorker();
+	
+	void start();
+	void stop();
+	
+	/**
+	 * Sets the map used for adaptive requests.  Only call while stopped.
+	 */
+	void setAdaptiveMap(const AdaptiveContourMap *map);
+	
+	/**
+	 * Queues a camera for processing, replacing any pending request.
+	 */
+	void request(const ViewRequest &request);
+	
+	/**
+	 * Makes the most recently finished result the front buffer.  Returns
+	 * true if a newer result than the current front buffer was available.
+	 * Call from the thread that reads front().
+	 */
+	bool acquire();
+	
+	/**
+	 * Returns the most recently acquired result.
+	 */
+	const ViewState& front() const;
+	
+private:
+	void run();
+	
+	const Mesh &mesh_;
+	const ViewCurvatureCache &cache_;
+	const AdaptiveContourMap *adaptive_;
+	AdaptiveContourScratch scratch_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	ViewRequest pending_;
+	bool hasPending_, fresh_, quit_;
+	// front_ is read by display, back_ is written by the worker and ready_
+	// holds the newest finished result until display picks it up
+	ViewState buffers_[3];
+	int front_, ready_, back_;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "adaptive_contours.h"
+#include <algorithm>
+#include <math.h>
+using namespace OpenMesh;
+using namespace std;
+
+// Coarse faces whose normal is within this cosine of perpendicular to the
+// view are treated as near the silhouette
+static const float SILHOUETTE_BAND = 0.2f;
+
+void buildAdaptiveContourMap(const ProgressiveMesh &progressive, size_t coarseLevel, const Mesh &coarseMesh, const vector<unsigned int> &coarseIds, const ViewCurvatureCache &coarseCache, const vector<unsigned int> &fineIds, const ViewCurvatureCache &fineCache, AdaptiveContourMap &map) {
+    map.coarseMesh = &coarseMesh;
+    map.coarseCache = &coarseCache;
+    map.nFineVertices = fineIds.size();
+    map.nFineFaces = fineCache.faceVertices.size()/3;
+
+    // fine vertex -> coarse vertex it collapses into
+    vector<unsigned int> ancestor;
+    progressive.ancestors(coarseLevel, ancestor);
+    vector<int> coarseIndex(progressive.maxVertices(), -1);
+    for (size_t i = 0; i < coarseIds.size(); i++) coarseIndex[coarseIds[i]] = (int)i;
+
+    size_t nc = coarseIds.size();
+    vector<int> faceCoarse(3*map.nFineFaces);
+    map.first.assign(nc+1, 0);
+    for (size_t f = 0; f < map.nFineFaces; f++) {
+        int *c = &faceCoarse[3*f];
+        for (int k = 0; k < 3; k++) {
+            c[k] = coarseIndex[ancestor[fineIds[fineCache.faceVertices[3*f+k]]]];
+            // each coarse vertex lists the face once
+            if (c[k] < 0 || (k > 0 && c[k] == c[0]) || (k > 1 && c[k] == c[1])) c[k] = -1;
+            else map.first[c[k]+1]++;
+        }
+    }
+    for (size_t c = 0; c < nc; c++) map.first[c+1] += map.first[c];
+
+    map.fineFaces.resize(map.first[nc]);
+    vector<unsigned int> fill(map.first.begin(), map.first.end()-1);
+    for (size_t f = 0; f < map.nFineFaces; f++)
+        for (int k = 0; k < 3; k++)
+            if (faceCoarse[3*f+k] >= 0) map.fineFaces[fill[faceCoarse[3*f+k]]++] = (unsigned int)f;
+
+    map.valid = true;
+}
+
+void selectContourFaces(const AdaptiveContourMap &map, const ViewCurvatureCache &fineCache, Vec3f camPos, AdaptiveContourScratch &scratch) {
+    const Mesh &coarse = *map.coarseMesh;
+    const ViewCurvatureCache &coarseCache = *map.coarseCache;
+    evaluateViewCurvature(coarseCache, camPos, scratch.coarseField);
+    const vector<float> &kw = scratch.coarseField.viewCurvature;
+
+    // coarse faces where the view curvature changes sign or that are close
+    // to the silhouette
+    size_t nc = kw.size(), ncf = coarseCache.faceVertices.size()/3;
+    scratch.active.assign(nc, 0);
+    for (size_t f = 0; f < ncf; f++) {
+        const unsigned int *fv = &coarseCache.faceVertices[3*f];
+        float lo = min(kw[fv[0]], min(kw[fv[1]], kw[fv[2]]));
+        float hi = max(kw[fv[0]], max(kw[fv[1]], kw[fv[2]]));
+        bool keep = lo <= 0 && hi >= 0;
+        if (!keep) {
+            Mesh::FaceHandle fh((int)f);
+            Vec3f v = camPos - coarse.point(Mesh::VertexHandle(fv[0]));
+            keep = fabs(dot(coarse.normal(fh),v)) < SILHOUETTE_BAND*v.length();
+        }
+        if (keep) scratch.active[fv[0]] = scratch.active[fv[1]] = scratch.active[fv[2]] = 1;
+    }
+
+    // grow by one coarse ring, since the coarse zero crossing is only an
+    // estimate of the fine one
+    scratch.grown = scratch.active;
+    for (size_t f = 0; f < ncf; f++) {
+        const unsigned int *fv = &coarseCache.faceVertices[3*f];
+        if (scratch.active[fv[0]] || scratch.active[fv[1]] || scratch.active[fv[2]])
+            scratch.grown[fv[0]] = scratch.grown[fv[1]] = scratch.grown[fv[2]] = 1;
+    }
+
+    // gather the fine faces and vertices under the grown region, each once
+    if (scratch.faceStamp.size() != map.nFineFaces || scratch.vertexStamp.size() != map.nFineVertices || ++scratch.stamp == 0) {
+        scratch.faceStamp.assign(map.nFineFaces, 0);
+        scratch.vertexStamp.assign(map.nFineVertices, 0);
+        scratch.stamp = 1;
+    }
+    scratch.faces.clear();
+    scratch.vertices.clear();
+    for (size_t c = 0; c < nc; c++) {
+        if (!scratch.grown[c]) continue;
+        for (unsigned int i = map.first[c]; i < map.first[c+1]; i++) {
+            unsigned int f = map.fineFaces[i];
+            if (scratch.faceStamp[f] == scratch.stamp) continue;
+            scratch.faceStamp[f] = scratch.stamp;
+            scratch.faces.push_back(f);
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = fineCache.faceVertices[3*f+k];
+                if (scratch.vertexStamp[v] == scratch.stamp) continue;
+                scratch.vertexStamp[v] = scratch.stamp;
+                scratch.vertices.push_back(v);
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#include "chaining.h"
+#include <algorithm>
+using namespace OpenMesh;
+using namespace std;
+
+// Orders segment endpoints into chains.  Segment s has endpoints 2s and 2s+1
+// with keys keys[2s] and keys[2s+1]; two endpoints are joined when they are
+// the only two with their key.  Appends each chain to order as endpoint ids,
+// in walking order, and records its range in first/count.
+static void chainEndpoints(const vector<unsigned int> &keys, vector<unsigned int> &order, vector<int> &first, vector<int> &count) {
+    size_t nEnds = keys.size();
+    size_t nSegments = nEnds/2;
+    
+    // sort endpoints by key so that endpoints to be joined are adjacent
+    vector<pair<unsigned int, unsigned int> > ends(nEnds);
+    for (size_t i = 0; i < nEnds; i++) ends[i] = make_pair(keys[i], (unsigned int)i);
+    sort(ends.begin(), ends.end());
+    
+    vector<int> link(nEnds, -1);
+    for (size_t i = 0; i < nEnds; ) {
+        size_t j = i+1;
+        while (j < nEnds && ends[j].first == ends[i].first) j++;
+        unsigned int a = ends[i].second, b = ends[i+1 < nEnds ? i+1 : i].second;
+        if (j - i == 2 && a/2 != b/2) {
+            link[a] = b;
+            link[b] = a;
+        }
+        i = j;
+    }
+    
+    vector<bool> visited(nSegments, false);
+    for (size_t s = 0; s < nSegments; s++) {
+        if (visited[s]) continue;
+        
+        // walk backwards through endpoint 0 to the start of the chain; a
+        // closed loop gets back to s and starts there
+        unsigned int start = 2*s;
+        for (int e = link[2*s]; e >= 0; e = link[e^1]) {
+            if ((size_t)e/2 == s) {
+                start = 2*s;
+                break;
+            }
+            start = e^1;
+        }
+        
+        // walk forwards; consecutive segments share a point, so each one
+        // only adds its far end
+        first.push_back((int)order.size());
+        order.push_back(start);
+        for (unsigned int in = start; ; ) {
+            visited[in/2] = true;
+            order.push_back(in^1);
+            int next = link[in^1];
+            if (next < 0 || visited[next/2]) break;
+            in = next;
+        }
+        count.push_back((int)order.size() - first.back());
+    }
+}
+
+void chainContours(const ContourBuffer &contours, Polylines &polylines) {
+    polylines.clear();
+    
+    vector<unsigned int> keys(2*contours.size);
+    for (size_t i = 0; i < contours.size; i++) {
+        keys[2*i] = contours[i].e0;
+        keys[2*i+1] = contours[i].e1;
+    }
+    
+    vector<unsigned int> order;
+    chainEndpoints(keys, order, polylines.first, polylines.count);
+    polylines.points.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        const ContourSegment &s = contours[order[i]/2];
+        polylines.points[i] = (order[i] & 1) ? s.p1 : s.p0;
+    }
+}
+
+void chainLines(const Mesh &mesh, const vector<unsigned int> &lines, Polylines &polylines) {
+    polylines.clear();
+    
+    // the vertex indices themselves are the keys, and an endpoint id is the
+    // index into lines
+    vector<unsigned int> order;
+    chainEndpoints(lines, order, polylines.first, polylines.count);
+    polylines.points.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++)
+        polylines.points[i] = mesh.point(Mesh::VertexHandle(lines[order[i]]));
+}
@@ -0,0 +1,108 @@
+#include "contours.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+using namespace OpenMesh;
+using namespace std;
+
+// Suggestive contour through face f, if any
+static bool faceContour(const Mesh &mesh, const ViewCurvatureCache &cache, const Vec3f &camPos, const ViewCurvatureField &field, double angleThresh, double gradThresh, size_t f, ContourSegment &s) {
+    // Face data
+    Mesh::FaceHandle fh((int)f);
+    Vec3f n = mesh.normal(fh);
+    Vec3f Dw = field.viewCurvatureDerivative[f];
+    
+    // Per-vertex data
+    const unsigned int *fv = &cache.faceVertices[3*f];
+    const unsigned int *fe = &cache.faceEdges[3*f];
+    Vec3f p0 = mesh.point(Mesh::VertexHandle(fv[0]));
+    double kw0 = field.viewCurvature[fv[0]];
+    Vec3f w0 = field.w(fv[0]);
+    
+    Vec3f p1 = mesh.point(Mesh::VertexHandle(fv[1]));
+    double kw1 = field.viewCurvature[fv[1]];
+    Vec3f w1 = field.w(fv[1]);
+    
+    Vec3f p2 = mesh.point(Mesh::VertexHandle(fv[2]));
+    double kw2 = field.viewCurvature[fv[2]];
+    Vec3f w2 = field.w(fv[2]);
+    
+    // Centroid and view vector
+    Vec3f pC = (p0 + p1 + p2)/3;
+    Vec3f v = camPos - pC;
+    v.normalize();
+    
+    // Skip face if normal is close to view vector
+    if (acos(dot(v,n)) < angleThresh) return false;
+    
+    // Skip face if Dwkw is small and positive
+    Vec3f wC = (w0 + w1 + w2)/3;    // take w to be the average of vertex w's
+    double dirGrad = -dot(Dw,wC);
+    if (dirGrad < 0 || (dirGrad > 0 && dirGrad < gradThresh)) return false;
+    
+    // EXTENSION (maybe): Ignore segments that are too short or uninteresting?
+    // EXTENSION (maybe): Reintroduce segments that were discarded, but next to a non-discarded segment
+    
+    // Determine if face has zero crossings
+    if ((kw0 > 0 && kw1 > 0 && kw2 > 0) || (kw0 < 0 && kw1 < 0 && kw2 < 0)) return false;
+    // Zero crossings along edges 0->2 and 1->2
+    if ((kw0 < 0 && kw1 < 0) || (kw0 > 0 && kw1 > 0)) {
+        // lerp
+        s.p0 = p2*((0-kw0)/(kw2-kw0)) + p0*((kw2-0)/(kw2-kw0));
+        s.p1 = p2*((0-kw1)/(kw2-kw1)) + p1*((kw2-0)/(kw2-kw1));
+        s.e0 = fe[2];
+        s.e1 = fe[1];
+    // Zero crossings along edges 0->1 and 1->2
+    } else if ((kw0 < 0 && kw2 < 0) || (kw0 > 0 && kw2 > 0)) {
+        // lerp
+        s.p0 = p1*((0-kw0)/(kw1-kw0)) + p0*((kw1-0)/(kw1-kw0));
+        s.p1 = p2*((0-kw1)/(kw2-kw1)) + p1*((kw2-0)/(kw2-kw1));
+        s.e0 = fe[0];
+        s.e1 = fe[1];
+    // Zero crossings along edges 0->1 and 0->2
+    } else if ((kw1 < 0 && kw2 < 0) || (kw1 > 0 && kw2 > 0)) {
+        // lerp
+        s.p0 = p1*((0-kw0)/(kw1-kw0)) + p0*((kw1-0)/(kw1-kw0));
+        s.p1 = p2*((0-kw0)/(kw2-kw0)) + p0*((kw2-0)/(kw2-kw0));
+        s.e0 = fe[0];
+        s.e1 = fe[2];
+    } else return false;
+    return true;
+}
+
+// Extracts from faces[0..nf), or from faces 0..nf-1 if faces is null
+static void extractFaces(const Mesh &mesh, const ViewCurvatureCache &cache, const Vec3f &camPos, const ViewCurvatureField &field, double angleThresh, double gradThresh, const unsigned int *faces, size_t nf, ContourBuffer &contours) {
+    contours.size = 0;
+    if (nf == 0 || field.viewCurvature.empty()) return;
+    if (contours.segments.size() < nf) contours.segments.resize(nf);
+    
+    // Chunk c owns the slots of its own faces and fills them from the front,
+    // which can't overflow since each face adds at most one segment.
+    const size_t minChunk = 4096;
+    vector<size_t> chunkBegin(parallelChunks(nf, minChunk)), chunkSize(chunkBegin.size());
+    ContourSegment *out = &contours.segments[0];
+    parallelFor(0, nf, [&](size_t begin, size_t end, int chunk) {
+        size_t n = 0;
+        for (size_t k = begin; k < end; k++) {
+            size_t f = faces ? faces[k] : k;
+            if (faceContour(mesh, cache, camPos, field, angleThresh, gradThresh, f, out[begin+n])) n++;
+        }
+        chunkBegin[chunk] = begin;
+        chunkSize[chunk] = n;
+    }, minChunk);
+    
+    // Close the gaps between chunks, keeping face order
+    for (size_t c = 0; c < chunkBegin.size(); c++) {
+        if (chunkBegin[c] != contours.size)
+            memmove(out + contours.size, out + chunkBegin[c], chunkSize[c]*sizeof(ContourSegment));
+        contours.size += chunkSize[c];
+    }
+}
+
+void extractSuggestiveContours(const Mesh &mesh, const ViewCurvatureCache &cache, Vec3f camPos, const ViewCurvatureField &field, double angleThresh, double gradThresh, ContourBuffer &contours) {
+    extractFaces(mesh, cache, camPos, field, angleThresh, gradThresh, 0, cache.faceVertices.size()/3, contours);
+}
+
+void extractSuggestiveContours(const Mesh &mesh, const ViewCurvatureCache &cache, Vec3f camPos, const ViewCurvatureField &field, double angleThresh, double gradThresh, const vector<unsigned int> &faces, ContourBuffer &contours) {
+    extractFaces(mesh, cache, camPos, field, angleThresh, gradThresh, faces.empty() ? 0 : &faces[0], faces.size(), contours);
+}
@@ -1,130 +1,327 @@
 #include <Eigen/Core>
-#include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
 #include <iostream>
 #include <math.h>
+#if defined(__AVX2__) && defined(__FMA__)
+#define VIEW_CURVATURE_AVX2
+#include <immintrin.h>
+#endif
 #include "curvature.h"
+#include "parallel.h"
 using namespace OpenMesh;
 using namespace Eigen;
 using namespace std;
 
-void computeCurvature(Mesh &mesh, OpenMesh::VPropHandleT<CurvatureInfo> &curvature) {
-    for (Mesh::VertexIter v_it = mesh.vertices_begin(); v_it != mesh.vertices_end(); ++v_it) {
-        // Per-vertex normal
-		Vec3f normal = mesh.normal(v_it.handle());
-		Vector3d Nvi(normal[0],normal[1],normal[2]);
-        // Vertex position
-        Vec3f point_i = mesh.point(v_it.handle());
-        Vector3d vi(point_i[0],point_i[1],point_i[2]);
-        
-        // Estimate the matrix Mvi
-        Matrix3d normalProjection = Matrix3d::Identity()-Nvi*Nvi.transpose();
-        Matrix3d Mvi = Matrix3d::Zero();
-        double sumAreas = 0.0;
-        
-        for (Mesh::VertexOHalfedgeIter voh_it = mesh.voh_iter(v_it.handle()); voh_it; ++voh_it) {
-            // Neighbor vertex position
-            Vec3f point_j = mesh.point(mesh.to_vertex_handle(voh_it.handle()));
-            Vector3d vj(point_j[0],point_j[1],point_j[2]);
-            Vector3d vji = vj-vi;
-            
-            // Compute Tij
-            Vector3d Tij = (Matrix3d::Identity()-Nvi*Nvi.transpose())*vji;
-            Tij.normalize();
-            // Compute kij
-            double kij = 2*vji.dot(Nvi) / vji.dot(vji);
-            // Weight wij
-            double wij = mesh.calc_sector_area(voh_it.handle()) + mesh.calc_sector_area(mesh.opposite_halfedge_handle(voh_it.handle()));
-            sumAreas += wij;
-            
-            // Update Mvi
-            Mvi += wij*kij*Tij*Tij.transpose();
-        }
-        Mvi /= sumAreas;
+// Solves the symmetric 2x2 problem [a b; b c] in closed form.  Returns the
+// eigenvalues m1 >= m2 and the unit eigenvector (x,y) belonging to m1; the
+// eigenvector of m2 is (-y,x).  Returns false for an umbilic (a multiple of
+// the identity), in which case every direction is an eigenvector.
+static bool symmetricEigen2(double a, double b, double c, double &m1, double &m2, double &x, double &y) {
+    double mean = 0.5*(a+c);
+    double diff = 0.5*(a-c);
+    double r = sqrt(diff*diff + b*b);
+    m1 = mean + r;
+    m2 = mean - r;
+    if (r <= 1e-12*(fabs(a)+fabs(c))) {
+        x = 1; y = 0;
+        return false;
+    }
+    // null vector of [diff-r b; b -diff-r], taken from whichever row is
+    // better conditioned
+    if (diff >= 0) { x = diff + r; y = b; }
+    else           { x = b; y = r - diff; }
+    double len = sqrt(x*x + y*y);
+    x /= len;
+    y /= len;
+    return true;
+}
+
+// Curvature at a single vertex.  Only reads the mesh, so any number of threads
+// can run it at once on different vertices.
+static CurvatureInfo vertexCurvature(const Mesh &mesh, Mesh::VertexHandle vh) {
+    // Per-vertex normal
+    Vec3f normal = mesh.normal(vh);
+    Vector3d Nvi(normal[0],normal[1],normal[2]);
+    // Vertex position
+    Vec3f point_i = mesh.point(vh);
+    Vector3d vi(point_i[0],point_i[1],point_i[2]);
+    
+    // Orthonormal tangent basis (u,v).  Mvi is symmetric with Nvi in its null
+    // space, so it is fully described by its 2x2 restriction to this plane.
+    Vector3d u, v;
+    if (Nvi.squaredNorm() == 0) {
+        u = Vector3d::UnitX();
+        v = Vector3d::UnitY();
+    } else {
+        Nvi.normalize();
+        // cross with the axis least aligned with the normal
+        Vector3d axis = Vector3d::Zero();
+        int k = 0;
+        Nvi.cwiseAbs().minCoeff(&k);
+        axis(k) = 1;
+        u = Nvi.cross(axis).normalized();
+        v = Nvi.cross(u);
+    }
+    
+    // Estimate Mvi in the tangent basis: [m_uu m_uv; m_uv m_vv]
+    double muu = 0, muv = 0, mvv = 0;
+    double sumAreas = 0.0;
+    
+    for (Mesh::ConstVertexOHalfedgeIter voh_it = mesh.cvoh_iter(vh); voh_it; ++voh_it) {
+        // Neighbor vertex position
+        Vec3f point_j = mesh.point(mesh.to_vertex_handle(voh_it.handle()));
+        Vector3d vj(point_j[0],point_j[1],point_j[2]);
+        Vector3d vji = vj-vi;
         
-        // Determine curvatures and principal directions from Mvi
-        EigenSolver<Matrix3d> solver(Mvi);
+        // Tij in tangent coordinates
+        double tu = vji.dot(u);
+        double tv = vji.dot(v);
+        double tlen = sqrt(tu*tu + tv*tv);
+        if (tlen == 0) continue;
+        tu /= tlen;
+        tv /= tlen;
+        // Compute kij
+        double kij = 2*vji.dot(Nvi) / vji.dot(vji);
+        // Weight wij
+        double wij = mesh.calc_sector_area(voh_it.handle()) + mesh.calc_sector_area(mesh.opposite_halfedge_handle(voh_it.handle()));
+        sumAreas += wij;
         
-        Vector3d T1 = solver.pseudoEigenvectors().block(0,0,3,1);
-        double eig1 = real(solver.eigenvalues()(0));
-        Vector3d T2 = solver.pseudoEigenvectors().block(0,1,3,1);
-        double eig2 = real(solver.eigenvalues()(1));
+        // Update Mvi
+        muu += wij*kij*tu*tu;
+        muv += wij*kij*tu*tv;
+        mvv += wij*kij*tv*tv;
+    }
+    
+    CurvatureInfo info;
+    if (sumAreas <= 0) {
+        // isolated or degenerate vertex: no curvature information
+        info.curvatures[0] = info.curvatures[1] = 0;
+        info.directions[0] = Vec3f(u(0),u(1),u(2));
+        info.directions[1] = Vec3f(v(0),v(1),v(2));
+        return info;
+    }
+    muu /= sumAreas;
+    muv /= sumAreas;
+    mvv /= sumAreas;
+    
+    // Principal directions are the eigenvectors of the 2x2 restriction.  For
+    // an umbilic the basis (u,v) is as good as any other.
+    double m11, m22, x, y;
+    symmetricEigen2(muu, muv, mvv, m11, m22, x, y);
+    Vector3d T1 = x*u + y*v;
+    Vector3d T2 = -y*u + x*v;
+    
+    info.curvatures[0] = 3*m11-m22;
+    info.curvatures[1] = 3*m22-m11;
+    info.directions[0] = Vec3f(T1(0),T1(1),T1(2));
+    info.directions[1] = Vec3f(T2(0),T2(1),T2(2));
+    
+    if (fabs(info.curvatures[0]) > fabs(info.curvatures[1])) {
+        double temp = info.curvatures[0];
+        info.curvatures[0] = info.curvatures[1];
+        info.curvatures[1] = temp;
         
-        if (T1.cross(Nvi).norm() < 1e-5) {
-            T1 = solver.pseudoEigenvectors().block(0,2,3,1);
-            eig1 = real(solver.eigenvalues()(2));
-        } else if (T2.cross(Nvi).norm() < 1e-5) {
-            T2 = solver.pseudoEigenvectors().block(0,2,3,1);
-            eig2 = real(solver.eigenvalues()(2));
+        Vec3f temp2 = info.directions[0];
+        info.directions[0] = info.directions[1];
+        info.directions[1] = temp2;
+    }
+    
+    return info;
+}
+
+void computeCurvature(Mesh &mesh, OpenMesh::VPropHandleT<CurvatureInfo> &curvature) {
+    // Each chunk owns a contiguous run of vertices and writes only their
+    // CurvatureInfo, so threads never touch the same element and the result
+    // is the same for every thread count.
+    if (mesh.n_vertices() == 0) return;
+    CurvatureInfo *out = &mesh.property(curvature).data_vector()[0];
+    const Mesh &cmesh = mesh;
+    parallelFor(0, mesh.n_vertices(), [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; i++)
+            out[i] = vertexCurvature(cmesh, Mesh::VertexHandle((int)i));
+    });
+}
+
+void buildViewCurvatureCache(Mesh &mesh, OpenMesh::VPropHandleT<CurvatureInfo> &curvature, ViewCurvatureCache &cache) {
+    size_t nv = mesh.n_vertices(), nf = mesh.n_faces();
+    for (int c = 0; c < 3; c++) {
+        cache.t1[c].resize(nv);
+        cache.t2[c].resize(nv);
+    }
+    cache.k1.resize(nv);
+    cache.k2.resize(nv);
+    cache.pT1.resize(nv);
+    cache.pT2.resize(nv);
+    for (size_t i = 0; i < nv; i++) {
+        Mesh::VertexHandle vh((int)i);
+        const CurvatureInfo &info = mesh.property(curvature,vh);
+        Vec3f p = mesh.point(vh);
+        for (int c = 0; c < 3; c++) {
+            cache.t1[c][i] = info.directions[0][c];
+            cache.t2[c][i] = info.directions[1][c];
         }
+        cache.k1[i] = info.curvatures[0];
+        cache.k2[i] = info.curvatures[1];
+        cache.pT1[i] = dot(p,info.directions[0]);
+        cache.pT2[i] = dot(p,info.directions[1]);
+    }
+
+    // We'll use the finite elements piecewise hat method to find per-face gradients of the view curvature
+    // CS 348a doesn't cover how to differentiate functions on a mesh (Take CS 468! Spring 2013!) so we provide code here
+    // The gradient is linear in the vertex values: g1*(c1-c0) + g2*(c2-c0)
+    cache.faceVertices.resize(3*nf);
+    cache.faceEdges.resize(3*nf);
+    cache.faceGrad.resize(2*nf);
+    for (Mesh::FaceIter it = mesh.faces_begin(); it != mesh.faces_end(); ++it) {
+        size_t f = it.handle().idx();
+        Vec3f p[3];
         
-        double m11 = T1.transpose()*Mvi*T1;
-        double m22 = T2.transpose()*Mvi*T2;
-        
-        CurvatureInfo info;
-        info.curvatures[0] = 3*m11-m22;
-        info.curvatures[1] = 3*m22-m11;
-        info.directions[0] = Vec3f(T1(0),T1(1),T1(2));
-        info.directions[1] = Vec3f(T2(0),T2(1),T2(2));
-        
-        if (fabs(info.curvatures[0]) > fabs(info.curvatures[1])) {
-            double temp = info.curvatures[0];
-            info.curvatures[0] = info.curvatures[1];
-            info.curvatures[1] = temp;
-            
-            Vec3f temp2 = info.directions[0];
-            info.directions[0] = info.directions[1];
-            info.directions[1] = temp2;
+        Mesh::ConstFaceVertexIter fvIt = mesh.cfv_iter(it.handle());
+        for (int i = 0; i < 3; i++) {
+            p[i] = mesh.point(fvIt.handle());
+            cache.faceVertices[3*f+i] = fvIt.handle().idx();
+            ++fvIt;
+        }
+        const unsigned int *fv = &cache.faceVertices[3*f];
+        for (Mesh::ConstFaceHalfedgeIter fhIt = mesh.cfh_iter(it.handle()); fhIt; ++fhIt) {
+            unsigned int from = mesh.from_vertex_handle(fhIt.handle()).idx();
+            unsigned int to = mesh.to_vertex_handle(fhIt.handle()).idx();
+            for (int i = 0; i < 3; i++)
+                if ((fv[i] == from && fv[(i+1)%3] == to) || (fv[i] == to && fv[(i+1)%3] == from))
+                    cache.faceEdges[3*f+i] = mesh.edge_handle(fhIt.handle()).idx();
         }
         
-		mesh.property(curvature,v_it) = info;
-	}
+        Vec3f N = mesh.normal(it.handle());
+        double area = mesh.calc_sector_area(mesh.halfedge_handle(it.handle()));
+        
+        cache.faceGrad[2*f]   = (N%(p[0]-p[2]))/(2*area);
+        cache.faceGrad[2*f+1] = (N%(p[1]-p[0]))/(2*area);
+    }
+
+    cache.valid = true;
+    cache.upToDate = false;
 }
 
-void computeViewCurvature(Mesh &mesh, OpenMesh::Vec3f camPos, OpenMesh::VPropHandleT<CurvatureInfo> &curvature, OpenMesh::VPropHandleT<double> &viewCurvature, OpenMesh::FPropHandleT<OpenMesh::Vec3f> &viewCurvatureDerivative, OpenMesh::VPropHandleT<OpenMesh::Vec3f> &viewVecProjection) {
-    Mesh::VertexIter v_it, v_end = mesh.vertices_end();
-    for (v_it = mesh.vertices_begin(); v_it != v_end; ++v_it) {
-        // Compute view vector
-        Vec3f p = mesh.point(v_it.handle());
-        Vec3f v = camPos - p;
-        
-        // Project view vector onto tangent plane
-        CurvatureInfo info = mesh.property(curvature,v_it);
-        Vec3f T1 = info.directions[0];
-        Vec3f T2 = info.directions[1];
-        Vec3f w = dot(v,T1)*T1 + dot(v,T2)*T2;
-        w.normalize();
+void ViewCurvatureField::resize(size_t nVertices, size_t nFaces) {
+    viewCurvature.resize(nVertices);
+    for (int c = 0; c < 3; c++) viewVecProjection[c].resize(nVertices);
+    viewCurvatureDerivative.resize(nFaces);
+}
+
+// View curvature of vertex i.  With a = v.T1 and b = v.T2 the projected
+// view vector is w = (a*T1 + b*T2)/|(a,b)|, so cos^2(phi) and sin^2(phi)
+// are a^2/(a^2+b^2) and b^2/(a^2+b^2): no trigonometry needed.
+static inline void viewCurvatureVertex(const ViewCurvatureCache &cache, const Vec3f &camPos, size_t i, float *kw, float *wx, float *wy, float *wz) {
+    const float *t1x = &cache.t1[0][0], *t1y = &cache.t1[1][0], *t1z = &cache.t1[2][0];
+    const float *t2x = &cache.t2[0][0], *t2y = &cache.t2[1][0], *t2z = &cache.t2[2][0];
+    float a = camPos[0]*t1x[i] + camPos[1]*t1y[i] + camPos[2]*t1z[i] - cache.pT1[i];
+    float b = camPos[0]*t2x[i] + camPos[1]*t2y[i] + camPos[2]*t2z[i] - cache.pT2[i];
+    float len2 = a*a + b*b;
+    if (len2 == 0) {
+        // looking straight down the normal: no preferred tangent direction
+        kw[i] = cache.k1[i];
+        wx[i] = wy[i] = wz[i] = 0;
+        return;
+    }
+    float invLen = 1/sqrtf(len2);
+    float ca = a*invLen, sb = b*invLen;
+    kw[i] = cache.k1[i]*ca*ca + cache.k2[i]*sb*sb;
+    wx[i] = t1x[i]*ca + t2x[i]*sb;
+    wy[i] = t1y[i]*ca + t2y[i]*sb;
+    wz[i] = t1z[i]*ca + t2z[i]*sb;
+}
+
+// View curvature for vertices [begin,end)
+static void viewCurvatureScalar(const ViewCurvatureCache &cache, const Vec3f &camPos, size_t begin, size_t end, float *kw, float *wx, float *wy, float *wz) {
+    for (size_t i = begin; i < end; i++)
+        viewCurvatureVertex(cache, camPos, i, kw, wx, wy, wz);
+}
+
+static inline void viewCurvatureGradient(const ViewCurvatureCache &cache, const float *kw, size_t f, ViewCurvatureField &field) {
+    const unsigned int *fv = &cache.faceVertices[3*f];
+    float c0 = kw[fv[0]];
+    field.viewCurvatureDerivative[f] = cache.faceGrad[2*f]*(kw[fv[1]]-c0) + cache.faceGrad[2*f+1]*(kw[fv[2]]-c0);
+}
+
+#ifdef VIEW_CURVATURE_AVX2
+// Same as viewCurvatureScalar, 8 vertices per iteration.  Returns the index
+// of the first vertex left for the scalar tail.
+static size_t viewCurvatureAVX2(const ViewCurvatureCache &cache, const Vec3f &camPos, size_t n, float *kw, float *wx, float *wy, float *wz) {
+    const __m256 cx = _mm256_set1_ps(camPos[0]);
+    const __m256 cy = _mm256_set1_ps(camPos[1]);
+    const __m256 cz = _mm256_set1_ps(camPos[2]);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 t1x = _mm256_loadu_ps(&cache.t1[0][i]);
+        __m256 t1y = _mm256_loadu_ps(&cache.t1[1][i]);
+        __m256 t1z = _mm256_loadu_ps(&cache.t1[2][i]);
+        __m256 t2x = _mm256_loadu_ps(&cache.t2[0][i]);
+        __m256 t2y = _mm256_loadu_ps(&cache.t2[1][i]);
+        __m256 t2z = _mm256_loadu_ps(&cache.t2[2][i]);
+        __m256 k1 = _mm256_loadu_ps(&cache.k1[i]);
+        __m256 k2 = _mm256_loadu_ps(&cache.k2[i]);
         
-        // store w vector for rendering
-        mesh.property(viewVecProjection,v_it) = w;
+        __m256 a = _mm256_fmadd_ps(cz, t1z, _mm256_fmadd_ps(cy, t1y, _mm256_fmsub_ps(cx, t1x, _mm256_loadu_ps(&cache.pT1[i]))));
+        __m256 b = _mm256_fmadd_ps(cz, t2z, _mm256_fmadd_ps(cy, t2y, _mm256_fmsub_ps(cx, t2x, _mm256_loadu_ps(&cache.pT2[i]))));
+        __m256 len2 = _mm256_fmadd_ps(a, a, _mm256_mul_ps(b, b));
+        __m256 degenerate = _mm256_cmp_ps(len2, zero, _CMP_EQ_OQ);
         
-        // Use components in principal directions to compute view curvature
-        double k1 = info.curvatures[0];
-        double k2 = info.curvatures[1];
-        double phi = acos(dot(w,T1));
-        double cosPhi = cos(phi);
-        double sinPhi = sin(phi);
-        double kw = k1*cosPhi*cosPhi + k2*sinPhi*sinPhi;
+        // zero-length lanes divide 1 by 1 and are patched up below
+        __m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_blendv_ps(len2, one, degenerate)));
+        __m256 ca = _mm256_blendv_ps(_mm256_mul_ps(a, invLen), zero, degenerate);
+        __m256 sb = _mm256_blendv_ps(_mm256_mul_ps(b, invLen), zero, degenerate);
         
-        mesh.property(viewCurvature,v_it) = k1*cosPhi*cosPhi + k2*sinPhi*sinPhi;
+        __m256 k = _mm256_fmadd_ps(_mm256_mul_ps(k1, ca), ca, _mm256_mul_ps(_mm256_mul_ps(k2, sb), sb));
+        _mm256_storeu_ps(&kw[i], _mm256_blendv_ps(k, k1, degenerate));
+        _mm256_storeu_ps(&wx[i], _mm256_fmadd_ps(t1x, ca, _mm256_mul_ps(t2x, sb)));
+        _mm256_storeu_ps(&wy[i], _mm256_fmadd_ps(t1y, ca, _mm256_mul_ps(t2y, sb)));
+        _mm256_storeu_ps(&wz[i], _mm256_fmadd_ps(t1z, ca, _mm256_mul_ps(t2z, sb)));
     }
+    return i;
+}
+#endif
+
+void evaluateViewCurvature(const ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, ViewCurvatureField &field) {
+    size_t nv = cache.k1.size();
+    size_t nf = cache.faceGrad.size()/2;
+    field.resize(nv, nf);
+    if (nv == 0) return;
+    
+    float *kw = &field.viewCurvature[0];
+    float *wx = &field.viewVecProjection[0][0];
+    float *wy = &field.viewVecProjection[1][0];
+    float *wz = &field.viewVecProjection[2][0];
+    size_t done = 0;
+#ifdef VIEW_CURVATURE_AVX2
+    done = viewCurvatureAVX2(cache, camPos, nv, kw, wx, wy, wz);
+#endif
+    viewCurvatureScalar(cache, camPos, done, nv, kw, wx, wy, wz);
+
+    for (size_t f = 0; f < nf; f++) viewCurvatureGradient(cache, kw, f, field);
+}
+
+void evaluateViewCurvature(const ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, const std::vector<unsigned int> &vertices, const std::vector<unsigned int> &faces, ViewCurvatureField &field) {
+    size_t nv = cache.k1.size();
+    field.resize(nv, cache.faceGrad.size()/2);
+    if (nv == 0) return;
+
+    float *kw = &field.viewCurvature[0];
+    float *wx = &field.viewVecProjection[0][0];
+    float *wy = &field.viewVecProjection[1][0];
+    float *wz = &field.viewVecProjection[2][0];
+    for (size_t k = 0; k < vertices.size(); k++)
+        viewCurvatureVertex(cache, camPos, vertices[k], kw, wx, wy, wz);
+    for (size_t k = 0; k < faces.size(); k++)
+        viewCurvatureGradient(cache, kw, faces[k], field);
+}
+
+bool updateViewCurvature(ViewCurvatureCache &cache, OpenMesh::Vec3f camPos, ViewCurvatureField &field) {
+    if (!cache.valid || (cache.upToDate && camPos == cache.lastCamPos)) return false;
 
-	// We'll use the finite elements piecewise hat method to find per-face gradients of the view curvature
-	// CS 348a doesn't cover how to differentiate functions on a mesh (Take CS 468! Spring 2013!) so we provide code here
-	
-	for (Mesh::FaceIter it = mesh.faces_begin(); it != mesh.faces_end(); ++it) {
-		double c[3];
-		Vec3f p[3];
-		
-		Mesh::ConstFaceVertexIter fvIt = mesh.cfv_iter(it);
-		for (int i = 0; i < 3; i++) {
-			p[i] = mesh.point(fvIt.handle());
-			c[i] = mesh.property(viewCurvature,fvIt.handle());
-			++fvIt;
-		}
-		
-		Vec3f N = mesh.normal(it.handle());
-		double area = mesh.calc_sector_area(mesh.halfedge_handle(it.handle()));
-
-		mesh.property(viewCurvatureDerivative,it) = (N%(p[0]-p[2]))*(c[1]-c[0])/(2*area) + (N%(p[1]-p[0]))*(c[2]-c[0])/(2*area);
-	}
+    evaluateViewCurvature(cache, camPos, field);
+    cache.lastCamPos = camPos;
+    cache.upToDate = true;
+    return true;
 }
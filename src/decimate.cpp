@@ -1,215 +1,299 @@
 #include "decimate.h"
 #include <iostream>
-#include <set>
 #include <float.h>
 #include <math.h>
+#include <algorithm>
+#include "parallel.h"
 using namespace OpenMesh;
 
-VPropHandleT<Quadricd> vquadric;
-VPropHandleT<float> vprio;
-VPropHandleT<Mesh::HalfedgeHandle> vtarget;
-
-
-void initDecimation(Mesh & mesh);
-bool is_collapse_legal(Mesh &mesh, Mesh::HalfedgeHandle _hh);
-float priority(Mesh &mesh, Mesh::HalfedgeHandle _heh);
-void decimate(Mesh &mesh, unsigned int _n_vertices);
-void enqueue_vertex(Mesh &mesh, Mesh::VertexHandle vh); 
-
-
-// access quadric of vertex _vh
-Quadricd& quadric(Mesh& mesh, Mesh::VertexHandle _vh) {
-	return mesh.property(vquadric, _vh);
+void simplify(Mesh &mesh, float percentage, bool parallel) {
+	Decimator decimator(mesh);
+	decimator.simplify(percentage, parallel);
 }
 
-// access priority of vertex _vh
-float& priority(Mesh& mesh, Mesh::VertexHandle _vh) {
-	return mesh.property(vprio, _vh);
+Decimator::Decimator(Mesh &mesh) : mesh_(mesh), records_(0) {
+	// add required properties; status and face normals are left on the
+	// mesh afterwards since the viewer needs them as well
+	mesh_.request_vertex_status();
+	mesh_.request_edge_status();
+	mesh_.request_face_status();
+	mesh_.request_face_normals();
+	mesh_.add_property(vquadric_);
+	mesh_.add_property(vtarget_);
+	mesh_.add_property(ecost_);
+	mesh_.add_property(eposition_);
 }
 
-// access target halfedge of vertex _vh
-Mesh::HalfedgeHandle& target(Mesh& mesh, Mesh::VertexHandle _vh) {
-	return mesh.property(vtarget, _vh);
+Decimator::~Decimator() {
+	mesh_.remove_property(vquadric_);
+	mesh_.remove_property(vtarget_);
+	mesh_.remove_property(ecost_);
+	mesh_.remove_property(eposition_);
 }
 
+void Decimator::simplify(float percentage, bool parallel) {
+	// compute normals & quadrics
+	initQuadrics();
 
-// NOTE:  We're making a global pointer to the mesh object here for notational convenience.
-//    This will NOT work if you make your code multithreaded and is horrible programming practice.
-//    But, it works and we're not asking you to implement this part.
+	// decimate
+	unsigned int nVertices = (unsigned int) (percentage * mesh_.n_vertices());
+	if (parallel) decimateParallel(nVertices);
+	else decimate(nVertices);
+	std::cout << "Simplifying to #vertices: " << (int) (mesh_.n_vertices()) << std::endl;
+}
 
-Mesh *meshPtr;
+void Decimator::initQuadrics() {
+	// compute face normals
+	mesh_.update_face_normals();
+
+	// Each face plane is turned into a quadric once ...
+	size_t nf = mesh_.n_faces(), nv = mesh_.n_vertices();
+	std::vector<Quadricd> faceQuadric(nf);
+	parallelFor(0, nf, [&](size_t begin, size_t end, int) {
+		for (size_t f = begin; f < end; f++) {
+			Mesh::FaceHandle fh((int)f);
+			Mesh::Point n = mesh_.normal(fh);
+			Mesh::Point v = mesh_.point(mesh_.to_vertex_handle(mesh_.halfedge_handle(fh)));
+			// Determine plane equation
+			// ax + by + cz + d = 0
+			// n[0](x-v[0])+n[1](y-v[1])+n[2](z-v[2])=0
+			double a = n[0], b = n[1], c = n[2];
+			double d = -dot(n,v);
+			// Normalize plane vector <a,b,c,d>
+			double one_over_length = 1.0/sqrt(a*a + b*b + c*c + d*d);
+			a *= one_over_length; b *= one_over_length;
+			c *= one_over_length; d *= one_over_length;
+			faceQuadric[f] = Quadricd(a,b,c,d);
+		}
+	});
+
+	// ... and each vertex sums the quadrics of its faces.  Every vertex
+	// only writes its own quadric, so no locking or per-thread copies.
+	parallelFor(0, nv, [&](size_t begin, size_t end, int) {
+		for (size_t i = begin; i < end; i++) {
+			Mesh::VertexHandle vh((int)i);
+			Quadricd &q = quadric(vh);
+			q.clear();
+			for (Mesh::VertexFaceIter vf_it = mesh_.vf_iter(vh); vf_it; ++vf_it)
+				q += faceQuadric[vf_it.handle().idx()];
+		}
+	});
+}
 
-// compare functor for priority queue
-struct VertexCmp {
-	bool operator()(Mesh::VertexHandle _v0, Mesh::VertexHandle _v1) const {
-		Mesh &mesh = *meshPtr;
-		// std::set needs UNIQUE keys -> handle equal priorities
-		return ((priority(mesh,_v0) == priority(mesh,_v1)) ?
-				(_v0.idx() < _v1.idx()) : (priority(mesh,_v0) < priority(mesh,_v1)));
-	}
-};
+// Same test as Mesh::is_collapse_ok, but without the tagged status bits
+// that one uses to intersect the one-rings, so it only reads the mesh and
+// can run on several vertices at once.
+bool Decimator::isCollapseOk(Mesh::HalfedgeHandle v0v1)
+{
+    if (mesh_.status(mesh_.edge_handle(v0v1)).deleted())
+        return false;
 
-std::set<Mesh::VertexHandle, VertexCmp> queue;
+    Mesh::HalfedgeHandle v1v0 = mesh_.opposite_halfedge_handle(v0v1);
+    Mesh::VertexHandle v0 = mesh_.to_vertex_handle(v1v0);
+    Mesh::VertexHandle v1 = mesh_.to_vertex_handle(v0v1);
+    if (mesh_.status(v0).deleted() || mesh_.status(v1).deleted())
+        return false;
 
-void simplify(Mesh &mesh, float percentage) {
-	meshPtr = &mesh; // NEVER EVER DO THIS IN REAL LIFE
+    // the edges v1-vl and vl-v0 must not both be boundary edges
+    Mesh::VertexHandle vl, vr;
+    Mesh::HalfedgeHandle h1, h2;
+    if (!mesh_.is_boundary(v0v1)) {
+        h1 = mesh_.next_halfedge_handle(v0v1);
+        h2 = mesh_.next_halfedge_handle(h1);
+        vl = mesh_.to_vertex_handle(h1);
+        if (mesh_.is_boundary(mesh_.opposite_halfedge_handle(h1)) &&
+            mesh_.is_boundary(mesh_.opposite_halfedge_handle(h2)))
+            return false;
+    }
 
-	// add required properties
-	mesh.request_vertex_status();
-	mesh.request_edge_status();
-	mesh.request_face_status();
-	mesh.request_face_normals();
-	mesh.add_property(vquadric);
-	mesh.add_property(vprio);
-	mesh.add_property(vtarget);
+    // the edges v0-vr and vr-v1 must not both be boundary edges
+    if (!mesh_.is_boundary(v1v0)) {
+        h1 = mesh_.next_halfedge_handle(v1v0);
+        h2 = mesh_.next_halfedge_handle(h1);
+        vr = mesh_.to_vertex_handle(h1);
+        if (mesh_.is_boundary(mesh_.opposite_halfedge_handle(h1)) &&
+            mesh_.is_boundary(mesh_.opposite_halfedge_handle(h2)))
+            return false;
+    }
 
-	// compute normals & quadrics
-	initDecimation(mesh);
+    // if vl and vr are equal or both invalid -> fail
+    if (vl == vr)
+        return false;
 
-	// decimate
-	decimate(mesh, (int) (percentage * mesh.n_vertices()));
-	std::cout << "Simplifying to #vertices: " << (int) (mesh.n_vertices()) << std::endl;
-    
-    // write mesh to debug
-    IO::write_mesh(mesh, "models/test.off");
-}
+    // an edge between two boundary vertices should be a boundary edge
+    if (mesh_.is_boundary(v0) && mesh_.is_boundary(v1) &&
+        !mesh_.is_boundary(v0v1) && !mesh_.is_boundary(v1v0))
+        return false;
 
-void initDecimation(Mesh &mesh) {
-	// compute face normals
-	mesh.update_face_normals();
-
-	Mesh::VertexIter v_it, v_end = mesh.vertices_end();
-	Mesh::Point n;
-	Mesh::VertexFaceIter vf_it;          // To iterate through incident faces
-	double a, b, c, d, length, one_over_length;
-	Mesh::Scalar sum;
-    
-	for (v_it = mesh.vertices_begin(); v_it != v_end; ++v_it) {
-		priority(mesh, v_it) = -1.0;
-		quadric(mesh, v_it).clear();
-		sum = 0;                            // Reset for each iteration
-
-        // Calculate vertex quadrics from adjacent faces
-        Mesh::Point v = mesh.point(v_it.handle());
-        for (vf_it = mesh.vf_iter(v_it.handle()); vf_it; ++vf_it) {
-            n = mesh.normal(vf_it.handle());
-            // Determine plane equation
-            // ax + by + cz + d = 0
-            // n[0](x-v[0])+n[1](y-v[1])+n[2](z-v[2])=0
-            a = n[0]; b = n[1]; c = n[2];
-            d = -dot(n,v);
-            // Normalize plane vector <a,b,c,d>
-            length = sqrt(a*a + b*b + c*c + d*d);
-            one_over_length = 1.0f/length;
-            a *= one_over_length; b *= one_over_length;
-            c *= one_over_length; d *= one_over_length;
-            // Construct quadric matrix for ith face and sum
-            Quadricd qi(a,b,c,d);
-            quadric(mesh, v_it) += qi;
-        }
-	}
-    std::cout << "Finished init" << std::endl;
+    // the one-rings of v0 and v1 may only share vl and vr
+    for (Mesh::VVIter a = mesh_.vv_iter(v0); a; ++a) {
+        if (a.handle() == vl || a.handle() == vr) continue;
+        for (Mesh::VVIter b = mesh_.vv_iter(v1); b; ++b)
+            if (a.handle() == b.handle()) return false;
+    }
+
+    return true;
 }
 
-bool is_collapse_legal(Mesh &mesh, Mesh::HalfedgeHandle _hh)
+bool Decimator::isCollapseLegal(Mesh::HalfedgeHandle _hh)
 {
     // collect vertices
     Mesh::VertexHandle v0, v1;
-    v0 = mesh.from_vertex_handle(_hh);
-    v1 = mesh.to_vertex_handle(_hh);
+    v0 = mesh_.from_vertex_handle(_hh);
+    v1 = mesh_.to_vertex_handle(_hh);
 
 
     // collect faces
-    Mesh::FaceHandle fl = mesh.face_handle(_hh);
-    Mesh::FaceHandle fr = mesh.face_handle(mesh.opposite_halfedge_handle(_hh));
-
-
-    // backup point positions
-    Mesh::Point p0 = mesh.point(v0);
-    Mesh::Point p1 = mesh.point(v1);
+    Mesh::FaceHandle fl = mesh_.face_handle(_hh);
+    Mesh::FaceHandle fr = mesh_.face_handle(mesh_.opposite_halfedge_handle(_hh));
 
 
     // topological test
-    if (!mesh.is_collapse_ok(_hh))
+    if (!isCollapseOk(_hh))
         return false;
 
     // test boundary stuff
-    if (mesh.is_boundary(v0) && !mesh.is_boundary(v1))
+    if (mesh_.is_boundary(v0) && !mesh_.is_boundary(v1))
         return false;
 
-    for (Mesh::VertexFaceIter vfIt = mesh.vf_iter(v0); vfIt; ++vfIt) {
-        if (vfIt.handle() == fl || vfIt.handle() == fr) continue;
+    // where the surviving vertex ends up
+    Mesh::Point pNew = edgePosition(mesh_.edge_handle(_hh));
 
-        Mesh::Point p[3];
+    // no face around either endpoint may flip or tilt too far
+    Mesh::VertexHandle ends[2] = { v0, v1 };
+    for (int k = 0; k < 2; k++) {
+        for (Mesh::VertexFaceIter vfIt = mesh_.vf_iter(ends[k]); vfIt; ++vfIt) {
+            if (vfIt.handle() == fl || vfIt.handle() == fr) continue;
 
-        Mesh::ConstFaceVertexIter cfvIt = mesh.cfv_iter(vfIt.handle());
-        p[0] = mesh.point(cfvIt.handle());
-        p[1] = mesh.point((++cfvIt).handle());
-        p[2] = mesh.point((++cfvIt).handle());
+            Mesh::Point p[3], q[3];
 
-        Mesh::Point q[3];
+            Mesh::ConstFaceVertexIter cfvIt = mesh_.cfv_iter(vfIt.handle());
+            for (int i = 0; i < 3; i++, ++cfvIt) {
+                p[i] = mesh_.point(cfvIt.handle());
+                q[i] = (cfvIt.handle() == v0 || cfvIt.handle() == v1)? pNew : p[i];
+            }
 
-        for (int i = 0; i < 3; i++)
-            q[i] = (p[i] == p0)? p1 : p[i];
+            Mesh::Point n1 = (p[1]-p[0])%(p[2]-p[0]);
+            Mesh::Point n2 = (q[1]-q[0])%(q[2]-q[0]);
 
-        Mesh::Point n1 = (p[1]-p[0])%(p[2]-p[0]);
-        Mesh::Point n2 = (q[1]-q[0])%(q[2]-q[0]);
-
-        if ((n1|n2) < n1.length()*n2.length()/sqrt(2.)) return false;
+            if ((n1|n2) < n1.length()*n2.length()/sqrt(2.)) return false;
+        }
     }
 
     return true;
 }
 
 
-float priority(Mesh &mesh, Mesh::HalfedgeHandle _heh) {
+float Decimator::priority(Mesh::HalfedgeHandle _heh) {
     // return priority: the smaller the better
-	// use quadrics to estimate approximation error
-	Mesh::VertexHandle v0, v1;
-    v0 = mesh.from_vertex_handle(_heh);
-    v1 = mesh.to_vertex_handle(_heh);
-    
-    // Quadrics from halfedge vertices
-    Quadricd q0 = quadric(mesh, v0);
-    Quadricd q1 = quadric(mesh, v1);
-    Vec3f p0 = mesh.point(v0);
-    Vec3f p1 = mesh.point(v1);
-    
-    // Quadrics of each vertex evaluated at other vertex
-    return q0(p1)+q1(p1);
+	// the error of the summed quadric at the best position does not depend
+	// on the direction, so it is cached per edge
+	return edgeCost(mesh_.edge_handle(_heh));
 }
 
-void enqueue_vertex(Mesh &mesh, Mesh::VertexHandle _vh) {
-	float prio, min_prio(FLT_MAX);
+void Decimator::updateEdge(Mesh::EdgeHandle _eh) {
+	Mesh::HalfedgeHandle hh = mesh_.halfedge_handle(_eh, 0);
+	Mesh::VertexHandle v0 = mesh_.from_vertex_handle(hh);
+	Mesh::VertexHandle v1 = mesh_.to_vertex_handle(hh);
+	Mesh::Point p0 = mesh_.point(v0);
+	Mesh::Point p1 = mesh_.point(v1);
+
+	Quadricd q = quadric(v0);
+	q += quadric(v1);
+
+	bool b0 = mesh_.is_boundary(v0), b1 = mesh_.is_boundary(v1);
+	Mesh::Point p;
+	double cost;
+	if (b0 != b1) {
+		// only the collapse onto the boundary vertex is legal, and it
+		// has to stay on the boundary
+		p = b0 ? p0 : p1;
+		cost = q(p);
+	} else if (!b0 && q.minimizer(p)) {
+		cost = q(p);
+	} else {
+		// singular quadric or boundary edge: best of the endpoints and
+		// the midpoint
+		Mesh::Point candidate[3] = { p0, p1, (p0 + p1) * 0.5f };
+		double candidateCost[3];
+		q.evaluate(candidate, 3, candidateCost);
+		p = candidate[0]; cost = candidateCost[0];
+		for (int k = 1; k < 3; k++)
+			if (candidateCost[k] < cost) { p = candidate[k]; cost = candidateCost[k]; }
+	}
+
+	mesh_.property(ecost_, _eh) = cost > 0.0 ? (float) cost : 0.0f;
+	mesh_.property(eposition_, _eh) = p;
+}
+
+float Decimator::edgeCost(Mesh::EdgeHandle _eh) {
+	if (mesh_.property(ecost_, _eh) < 0.0f) updateEdge(_eh);
+	return mesh_.property(ecost_, _eh);
+}
+
+const Mesh::Point& Decimator::edgePosition(Mesh::EdgeHandle _eh) {
+	if (mesh_.property(ecost_, _eh) < 0.0f) updateEdge(_eh);
+	return mesh_.property(eposition_, _eh);
+}
+
+void Decimator::invalidateEdges() {
+	for (unsigned int i = 0; i < mesh_.n_edges(); i++)
+		mesh_.property(ecost_, Mesh::EdgeHandle(i)) = -1.0f;
+}
+
+void Decimator::invalidateEdges(Mesh::VertexHandle _vh) {
+	for (Mesh::VEIter ve_it = mesh_.ve_iter(_vh); ve_it; ++ve_it)
+		mesh_.property(ecost_, ve_it.handle()) = -1.0f;
+}
+
+CollapseRecord Decimator::collapse(Mesh::HalfedgeHandle _hh) {
+	Mesh::VertexHandle from = mesh_.from_vertex_handle(_hh);
+	Mesh::VertexHandle to = mesh_.to_vertex_handle(_hh);
+	Mesh::Point p = edgePosition(mesh_.edge_handle(_hh));
+	CollapseRecord record = { from.idx(), to.idx(), p };
+
+	mesh_.collapse(_hh);
+	mesh_.set_point(to, p);
+	quadric(to) += quadric(from);
+
+	// every edge whose cost depends on the moved vertex is now incident to it
+	invalidateEdges(to);
+	return record;
+}
+
+Mesh::HalfedgeHandle Decimator::bestCollapse(Mesh::VertexHandle _vh, float &min_prio) {
+	float prio;
 	Mesh::HalfedgeHandle min_hh;
+	min_prio = FLT_MAX;
 
 	// find best out-going halfedge
-	for (Mesh::VOHIter vh_it(mesh, _vh); vh_it; ++vh_it) {
-		if (is_collapse_legal(mesh,vh_it)) {
-			prio = priority(mesh, vh_it);
+	for (Mesh::VOHIter vh_it(mesh_, _vh); vh_it; ++vh_it) {
+		if (isCollapseLegal(vh_it.handle())) {
+			prio = priority(vh_it.handle());
 			if (prio != -1.0 && prio < min_prio) {
 				min_prio = prio;
 				min_hh = vh_it.handle();
 			}
 		}
 	}
+	return min_hh;
+}
 
-	// update queue
-	if (priority(mesh, _vh) != -1.0) {
-		queue.erase(_vh);
-		priority(mesh, _vh) = -1.0;
-	}
+void Decimator::enqueueVertex(Mesh::VertexHandle _vh) {
+	float min_prio;
+	Mesh::HalfedgeHandle min_hh = bestCollapse(_vh, min_prio);
 
+	// update queue in place
 	if (min_hh.is_valid()) {
-		priority(mesh, _vh) = min_prio;
-		target(mesh, _vh) = min_hh;
-		queue.insert(_vh);
+		target(_vh) = min_hh;
+		queue_.update(_vh.idx(), min_prio);
+	} else {
+		queue_.remove(_vh.idx());
 	}
 }
 
-void decimate(Mesh &mesh, unsigned int _n_vertices) {
-	unsigned int nv(mesh.n_vertices());
-    std::cout << "Got to decimate" << std::endl;
+void Decimator::decimate(unsigned int _n_vertices) {
+	unsigned int nv(mesh_.n_vertices());
 
 	Mesh::HalfedgeHandle hh;
 	Mesh::VertexHandle to, from;
@@ -219,38 +303,131 @@ void decimate(Mesh &mesh, unsigned int _n_vertices) {
 	std::vector<Mesh::VertexHandle>::iterator or_it, or_end;
 
 	// build priority queue
-	Mesh::VertexIter v_it = mesh.vertices_begin(), v_end =
-			mesh.vertices_end();
+	Mesh::VertexIter v_it = mesh_.vertices_begin(), v_end =
+			mesh_.vertices_end();
 
-	queue.clear();
+	invalidateEdges();
+	queue_.reset(mesh_.n_vertices());
 	for (; v_it != v_end; ++v_it)
-		enqueue_vertex(mesh, v_it.handle());
+		enqueueVertex(v_it.handle());
 
     // Decimate using priority queue
-    while ((nv > _n_vertices) && !queue.empty()) {
+    while ((nv > _n_vertices) && !queue_.empty()) {
         // take 1st element of queue
-        from = *(queue.begin());
-        hh = target(mesh, from);
-        to = mesh.to_vertex_handle(hh);
-        queue.erase(from);
+        from = Mesh::VertexHandle(queue_.pop());
+        hh = target(from);
+        to = mesh_.to_vertex_handle(hh);
         // collapse halfedge
-        if (!is_collapse_legal(mesh, hh))
+        if (!isCollapseLegal(hh))
             continue;
-        mesh.collapse(hh);
-        quadric(mesh, to) += quadric(mesh, from);
+        CollapseRecord record = collapse(hh);
+        if (records_) records_->push_back(record);
         // update queue
-        enqueue_vertex(mesh, to);
-        for (vv_it = mesh.vv_iter(to); vv_it; ++vv_it) {
-            enqueue_vertex(mesh, vv_it.handle());
+        enqueueVertex(to);
+        for (vv_it = mesh_.vv_iter(to); vv_it; ++vv_it) {
+            enqueueVertex(vv_it.handle());
         }
         nv--;
     }
 
 	// clean up after decimation
-	queue.clear();
+	queue_.clear();
+
+	// now, delete the items marked to be deleted
+	mesh_.garbage_collection();
+}
+
+// Orders vertices by the cost of their best collapse, ties by index.
+struct CostLess {
+	const std::vector<float> &cost;
+	CostLess(const std::vector<float> &_cost) : cost(_cost) {}
+	bool operator()(unsigned int a, unsigned int b) const {
+		return cost[a] < cost[b] || (cost[a] == cost[b] && a < b);
+	}
+};
+
+void Decimator::decimateParallel(unsigned int _n_vertices) {
+	unsigned int n = mesh_.n_vertices();
+	unsigned int nv = 0;
+	for (unsigned int i = 0; i < n; i++)
+		if (!mesh_.status(Mesh::VertexHandle(i)).deleted()) nv++;
+
+	cost_.resize(n);
+	marked_.assign(n, 0);
+	invalidateEdges();
+
+	while (nv > _n_vertices) {
+		// refresh stale edge costs up front so the vertex pass below
+		// never writes to an edge shared with another thread
+		parallelFor(0, mesh_.n_edges(), [&](size_t begin, size_t end, int) {
+			for (size_t i = begin; i < end; i++) {
+				Mesh::EdgeHandle eh((int)i);
+				if (!mesh_.status(eh).deleted() && mesh_.property(ecost_, eh) < 0.0f)
+					updateEdge(eh);
+			}
+		});
+
+		// find the best collapse of every vertex; this only reads the mesh
+		parallelFor(0, n, [&](size_t begin, size_t end, int) {
+			for (size_t i = begin; i < end; i++) {
+				Mesh::VertexHandle vh((int)i);
+				Mesh::HalfedgeHandle hh;
+				if (!mesh_.status(vh).deleted()) hh = bestCollapse(vh, cost_[i]);
+				target(vh) = hh;
+				if (!hh.is_valid()) cost_[i] = FLT_MAX;
+			}
+		}, 256);
+
+		candidates_.clear();
+		for (unsigned int i = 0; i < n; i++)
+			if (cost_[i] != FLT_MAX) candidates_.push_back(i);
+		if (candidates_.empty()) break;
+
+		// only consider the cheapest quarter of the candidates, so a round
+		// does not spend its collapses on expensive edges
+		size_t considered = std::max<size_t>(1, candidates_.size()/4);
+		std::nth_element(candidates_.begin(), candidates_.begin() + (considered - 1),
+						 candidates_.end(), CostLess(cost_));
+		candidates_.resize(considered);
+		std::sort(candidates_.begin(), candidates_.end(), CostLess(cost_));
+
+		// greedily pick collapses whose closed one-rings (around both
+		// endpoints) do not touch any collapse picked before
+		size_t picked = 0;
+		for (size_t k = 0; k < candidates_.size() && picked < nv - _n_vertices; k++) {
+			Mesh::VertexHandle from(candidates_[k]);
+			Mesh::VertexHandle to = mesh_.to_vertex_handle(target(from));
+			bool free = !marked_[from.idx()] && !marked_[to.idx()];
+			for (Mesh::VVIter vv_it = mesh_.vv_iter(from); free && vv_it; ++vv_it)
+				free = !marked_[vv_it.handle().idx()];
+			for (Mesh::VVIter vv_it = mesh_.vv_iter(to); free && vv_it; ++vv_it)
+				free = !marked_[vv_it.handle().idx()];
+			if (!free) continue;
+
+			marked_[from.idx()] = marked_[to.idx()] = 1;
+			for (Mesh::VVIter vv_it = mesh_.vv_iter(from); vv_it; ++vv_it)
+				marked_[vv_it.handle().idx()] = 1;
+			for (Mesh::VVIter vv_it = mesh_.vv_iter(to); vv_it; ++vv_it)
+				marked_[vv_it.handle().idx()] = 1;
+			candidates_[picked++] = from.idx();
+		}
+
+		// picked collapses touch disjoint parts of the mesh, so their
+		// order within the round does not matter for the record either
+		size_t firstRecord = records_ ? records_->size() : 0;
+		if (records_) records_->resize(firstRecord + picked);
+		parallelFor(0, picked, [&](size_t begin, size_t end, int) {
+			for (size_t k = begin; k < end; k++) {
+				CollapseRecord record = collapse(target(Mesh::VertexHandle(candidates_[k])));
+				if (records_) (*records_)[firstRecord + k] = record;
+			}
+		}, 64);
+
+		nv -= picked;
+		std::fill(marked_.begin(), marked_.end(), 0);
+	}
 
 	// now, delete the items marked to be deleted
-	mesh.garbage_collection();
-    std::cout << "Out of decimate" << std::endl;
+	mesh_.garbage_collection();
 }
 
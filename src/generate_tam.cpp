@@ -0,0 +1,73 @@
+#include "tam_generator.h"
+#include "parallel.h"
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace std;
+
+void usage(const char *program) {
+	TamParameters defaults;
+	cout << "Usage: " << program << " [-s size] [-w width] [-l min,max] [-c candidates] [-r seed] [-t threads] output_directory\n";
+	cout << "\t-s size\t\tedge of the largest level (default: " << defaults.size << ")\n";
+	cout << "\t-w width\tstroke width in pixels (default: " << defaults.strokeWidth << ")\n";
+	cout << "\t-l min,max\tstroke length as a fraction of the texture (default: " << defaults.minLength << ',' << defaults.maxLength << ")\n";
+	cout << "\t-c candidates\trandom strokes tried per stroke placed (default: " << defaults.candidates << ")\n";
+	cout << "\t-r seed\t\trandom seed (default: " << defaults.seed << ")\n";
+	cout << "\t-t threads\tworker threads (default: one per core)\n";
+	cout << "Writes tam<tone><resolution>.bmp and tam.atlas to output_directory.\n";
+	exit(1);
+}
+
+// Generates a tonal art map and writes it both as the TAM images drawMesh
+// ships with and as a packed atlas
+int main(int argc, char** argv) {
+	TamParameters parameters;
+	int c;
+	while ((c = getopt(argc, argv, "s:w:l:c:r:t:")) != -1) {
+		if (c == 's') parameters.size = atoi(optarg);
+		else if (c == 'w') parameters.strokeWidth = atof(optarg);
+		else if (c == 'l') {
+			if (sscanf(optarg, "%f,%f", &parameters.minLength, &parameters.maxLength) != 2) usage(argv[0]);
+		}
+		else if (c == 'c') parameters.candidates = atoi(optarg);
+		else if (c == 'r') parameters.seed = atoi(optarg);
+		else if (c == 't') setNumThreads(atoi(optarg));
+		else usage(argv[0]);
+	}
+	if (optind >= argc || parameters.size <= 0 || (parameters.size & (parameters.size-1)) != 0) usage(argv[0]);
+	string directory = argv[optind];
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	TamAtlas atlas;
+	generateTam(parameters, atlas);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Generated a " << atlas.size << 'x' << atlas.size << " TAM in " << seconds << " s.\n";
+
+	for (int tone = 0; tone < TAM_TONES; tone++)
+		for (int l = 0; l < atlas.levels; l++) {
+			int size = atlas.size >> l;
+			const unsigned char *in = atlas.level(tone/3, l);
+			sf::Image image;
+			image.create(size, size);
+			for (int y = 0; y < size; y++)
+				for (int x = 0; x < size; x++) {
+					unsigned char v = in[4*((size_t)y*size + x) + tone%3];
+					image.setPixel(x, y, sf::Color(v, v, v, 255));
+				}
+			char name[64];
+			snprintf(name, sizeof(name), "/tam%d%d.bmp", tone, atlas.levels-1-l);
+			if (!image.saveToFile(directory + name)) {
+				cout << "Could not write " << directory << name << ".\n";
+				return 1;
+			}
+		}
+	if (!writeTamAtlas(directory + "/tam.atlas", atlas)) {
+		cout << "Could not write " << directory << "/tam.atlas.\n";
+		return 1;
+	}
+	cout << "Wrote " << directory << ".\n";
+	return 0;
+}
@@ -1,70 +1,242 @@
 #include "image_generation.h"
 #include "mesh_features.h"
+#include "parallel.h"
+#include "svg_writer.h"
 #include <GLUT/glut.h>
-#include <fstream>
+#include <iostream>
+#include <cmath>
 #include <set>
 #include <map>
 #include <list>
 using namespace OpenMesh;
 using namespace std;
 
-Vec3f toImagePlane(Vec3f point) {
-	GLdouble point3DX = point[0], point3DY = point[1], point3DZ = point[2];
-
+void getScreenProjection(ScreenProjection &projection) {
 	GLdouble modelMatrix[16], projMatrix[16];
-	GLint viewport[4];
 	glGetDoublev(GL_MODELVIEW_MATRIX, modelMatrix);
 	glGetDoublev(GL_PROJECTION_MATRIX, projMatrix);
-	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_VIEWPORT, projection.viewport);
 	
-	GLdouble point2DX, point2DY, point2DZ;
-	gluProject(point3DX, point3DY, point3DZ, modelMatrix, projMatrix, viewport, &point2DX, &point2DY, &point2DZ);
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++) {
+			double sum = 0;
+			for (int k = 0; k < 4; k++) sum += projMatrix[4*k+r]*modelMatrix[4*c+k];
+			projection.matrix[4*c+r] = sum;
+		}
+}
+
+void readDepthImage(const ScreenProjection &projection, DepthImage &image) {
+	image.x = projection.viewport[0];
+	image.y = projection.viewport[1];
+	image.width = projection.viewport[2];
+	image.height = projection.viewport[3];
+	image.depth.resize((size_t)image.width*image.height);
+	if (image.depth.empty()) return;
 	
-	return Vec3f(point2DX,point2DY,point2DZ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(image.x, image.y, image.width, image.height, GL_DEPTH_COMPONENT, GL_FLOAT, &image.depth[0]);
 }
 
-// Adapted from
-// http://stackoverflow.com/questions/1311869/opengl-how-to-determine-if-a-3d-rendered-point-is-occluded-by-other-3d-rende
-bool isVisible(Vec3f point) {
-	Vec3f projected = toImagePlane(point);
+void projectPoints(const ScreenProjection &projection, const Vec3f *points, size_t n, Vec3f *projected) {
+	const double *m = projection.matrix;
+	const int *vp = projection.viewport;
+	for (size_t i = 0; i < n; i++) {
+		double x = points[i][0], y = points[i][1], z = points[i][2];
+		double cx = m[0]*x + m[4]*y + m[8]*z + m[12];
+		double cy = m[1]*x + m[5]*y + m[9]*z + m[13];
+		double cz = m[2]*x + m[6]*y + m[10]*z + m[14];
+		double cw = m[3]*x + m[7]*y + m[11]*z + m[15];
+		if (cw <= 0) {
+			projected[i] = Vec3f(0,0,-1);
+			continue;
+		}
+		double inv = 1/cw;
+		projected[i] = Vec3f(vp[0] + vp[2]*(cx*inv + 1)/2,
+							 vp[1] + vp[3]*(cy*inv + 1)/2,
+							 (cz*inv + 1)/2);
+	}
+}
 
-	GLfloat bufDepth = 0.0;
-	glReadPixels(static_cast<GLint>( projected[0] ), static_cast<GLint>( projected[1] ),
-		     1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &bufDepth);
+// Rounding slack, in units of the spacing of depth values at z: the larger
+// of a float ULP and the resolution of a 24 bit depth buffer
+static const float DEPTH_ULPS = 4;
 
-	GLdouble EPSILON = 0.01;
-	return (bufDepth - projected[2]) > -EPSILON; // check sign!
+// How far behind the depth buffer a point of a line at depth z may be and
+// still count as visible.  The buffer holds the depth at pixel centers, so
+// a line whose depth changes by slope per pixel may differ from it by that
+// much on top of rounding.
+static float depthTolerance(float z, float slope) {
+	float ulp = max(nextafterf(z, 2.0f) - z, 1.0f/(1 << 24));
+	return DEPTH_ULPS*ulp + slope;
 }
 
-void writeImage(Mesh &mesh, int width, int height, string filename, Vec3f camPos) {
-	ofstream outfile(filename.c_str());
-	outfile << "<?xml version=\"1.0\" standalone=\"no\"?>\n";
-	outfile << "<svg width=\"5in\" height=\"5in\" viewBox=\"0 0 " << width << ' ' << height << "\">\n";
-	outfile << "<g stroke=\"black\" fill=\"black\">\n";
+bool isVisible(const DepthImage &image, const Vec3f &projected, float tolerance) {
+	if (projected[2] < 0) return false;
+	int px = (int)floor(projected[0]) - image.x, py = (int)floor(projected[1]) - image.y;
+	if (px < 0 || py < 0 || px >= image.width || py >= image.height) return true;
 	
-	// Sample code for generating image of the entire triangle mesh:
-	/*for (Mesh::ConstEdgeIter it = mesh.edges_begin(); it != mesh.edges_end(); ++it) {
-		Mesh::HalfedgeHandle h0 = mesh.halfedge_handle(it,0);
-		Mesh::HalfedgeHandle h1 = mesh.halfedge_handle(it,1);
-		Vec3f source(mesh.point(mesh.from_vertex_handle(h0)));
-		Vec3f target(mesh.point(mesh.from_vertex_handle(h1)));
-		
-		if (!isVisible(source) || !isVisible(target)) continue;
-		
-		Vec3f p1 = toImagePlane(source);
-		Vec3f p2 = toImagePlane(target);
-		outfile << "<line ";
-		outfile << "x1=\"" << p1[0] << "\" ";
-		outfile << "y1=\"" << height-p1[1] << "\" ";
-		outfile << "x2=\"" << p2[0] << "\" ";
-		outfile << "y2=\"" << height-p2[1] << "\" stroke-width=\"1\" />\n";
-	}*/
+	return image.depth[(size_t)py*image.width + px] - projected[2] > -tolerance;
+}
+
+void buildDepthPyramid(const DepthImage &image, DepthPyramid &pyramid) {
+	pyramid.image = &image;
+	pyramid.width.assign(1, image.width);
+	pyramid.height.assign(1, image.height);
+	pyramid.minDepth.resize(1);
+	pyramid.maxDepth.resize(1);
 	
-	// WRITE CODE HERE TO GENERATE A .SVG OF THE MESH --------------------------------------------------------------
+	int level = 0;
+	while (pyramid.width[level] > 1 || pyramid.height[level] > 1) {
+		int w = pyramid.width[level], h = pyramid.height[level];
+		int cw = (w+1)/2, ch = (h+1)/2;
+		const float *fineMin = level ? &pyramid.minDepth[level][0] : &image.depth[0];
+		const float *fineMax = level ? &pyramid.maxDepth[level][0] : &image.depth[0];
+		level++;
+		pyramid.width.push_back(cw);
+		pyramid.height.push_back(ch);
+		pyramid.minDepth.push_back(vector<float>((size_t)cw*ch));
+		pyramid.maxDepth.push_back(vector<float>((size_t)cw*ch));
+		float *coarseMin = &pyramid.minDepth[level][0], *coarseMax = &pyramid.maxDepth[level][0];
+		parallelFor(0, ch, [&](size_t begin, size_t end, int) {
+			for (size_t y = begin; y < end; y++)
+				for (int x = 0; x < cw; x++) {
+					int x0 = 2*x, y0 = 2*(int)y, x1 = min(x0+1, w-1), y1 = min(y0+1, h-1);
+					size_t i00 = (size_t)y0*w + x0, i01 = (size_t)y0*w + x1, i10 = (size_t)y1*w + x0, i11 = (size_t)y1*w + x1;
+					coarseMin[y*cw + x] = min(min(fineMin[i00], fineMin[i01]), min(fineMin[i10], fineMin[i11]));
+					coarseMax[y*cw + x] = max(max(fineMax[i00], fineMax[i01]), max(fineMax[i10], fineMax[i11]));
+				}
+		}, 64);
+	}
+}
+
+// Bounds the depth of the image over pixels [x0,x1] x [y0,y1], which must
+// lie inside it, with at most 2x2 texels of the coarsest level that fits
+static void depthBounds(const DepthPyramid &pyramid, int x0, int y0, int x1, int y1, float &lo, float &hi) {
+	size_t k = 0;
+	while ((x1 >> k) - (x0 >> k) > 1 || (y1 >> k) - (y0 >> k) > 1) k++;
+	x0 >>= k; x1 >>= k; y0 >>= k; y1 >>= k;
+	int w = pyramid.width[k];
+	const float *minDepth = k ? &pyramid.minDepth[k][0] : &pyramid.image->depth[0];
+	const float *maxDepth = k ? &pyramid.maxDepth[k][0] : &pyramid.image->depth[0];
+	lo = 1; hi = 0;
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++) {
+			lo = min(lo, minDepth[(size_t)y*w + x]);
+			hi = max(hi, maxDepth[(size_t)y*w + x]);
+		}
+}
+
+static void addInterval(vector< pair<float,float> > &intervals, float t0, float t1) {
+	if (!intervals.empty() && intervals.back().second == t0) intervals.back().second = t1;
+	else intervals.push_back(make_pair(t0, t1));
+}
+
+// Window depth is affine along a projected segment, so the depth of the
+// span [t0,t1] lies between the depths of its ends.  slope is the change
+// of depth per pixel along a-b.
+static void visibleSpan(const DepthPyramid &pyramid, const Vec3f &a, const Vec3f &b, float slope, float t0, float t1, vector< pair<float,float> > &intervals) {
+	const DepthImage &image = *pyramid.image;
+	Vec3f p0 = a + t0*(b-a), p1 = a + t1*(b-a);
+	
+	// pixel bounds relative to the image, clamped before converting since
+	// points far off screen project to huge coordinates
+	float fx0 = floor(min(p0[0], p1[0])) - image.x, fx1 = floor(max(p0[0], p1[0])) - image.x;
+	float fy0 = floor(min(p0[1], p1[1])) - image.y, fy1 = floor(max(p0[1], p1[1])) - image.y;
+	if (fx1 < 0 || fy1 < 0 || fx0 >= image.width || fy0 >= image.height) {
+		addInterval(intervals, t0, t1);
+		return;
+	}
+	bool inside = fx0 >= 0 && fy0 >= 0 && fx1 < image.width && fy1 < image.height;
+	int x0 = (int)max(fx0, 0.0f), x1 = (int)min(fx1, (float)(image.width-1));
+	int y0 = (int)max(fy0, 0.0f), y1 = (int)min(fy1, (float)(image.height-1));
+	
+	// Outside pixels are visible, so only an inside span can be hidden
+	float lo, hi;
+	depthBounds(pyramid, x0, y0, x1, y1, lo, hi);
+	float zMin = min(p0[2], p1[2]), zMax = max(p0[2], p1[2]);
+	if (zMax - lo < depthTolerance(zMax, slope)) {
+		addInterval(intervals, t0, t1);
+		return;
+	}
+	if (inside && zMin - hi >= depthTolerance(zMin, slope)) return;
+	
+	// Down to a pixel, the middle decides
+	float tm = (t0 + t1)/2;
+	if ((fx1 - fx0 <= 1 && fy1 - fy0 <= 1) || tm <= t0 || tm >= t1) {
+		Vec3f pm = a + tm*(b-a);
+		if (isVisible(image, pm, depthTolerance(pm[2], slope))) addInterval(intervals, t0, t1);
+		return;
+	}
+	visibleSpan(pyramid, a, b, slope, t0, tm, intervals);
+	visibleSpan(pyramid, a, b, slope, tm, t1, intervals);
+}
+
+void visibleIntervals(const DepthPyramid &pyramid, const Vec3f &a, const Vec3f &b, vector< pair<float,float> > &intervals) {
+	// behind the camera
+	if (a[2] < 0 || b[2] < 0) return;
+	if (pyramid.image->depth.empty()) {
+		addInterval(intervals, 0, 1);
+		return;
+	}
+	// a segment shorter than a pixel changes its whole depth within one
+	float length = max(sqrt((b[0]-a[0])*(b[0]-a[0]) + (b[1]-a[1])*(b[1]-a[1])), 1.0f);
+	visibleSpan(pyramid, a, b, fabs(b[2]-a[2])/length, 0, 1, intervals);
+}
+
+void writeImage(int width, int height, string filename, const ScreenProjection &projection, const DepthImage &depth, const vector<const Polylines*> &lines) {
+	SvgWriter svg;
+	if (!svg.open(filename, width, height)) {
+		cerr << "Could not write " << filename << endl;
+		return;
+	}
+	
+	// Chained feature lines and contours, cut wherever a segment passes
+	// behind the surface.  Each set of polylines is one path element.
+	DepthPyramid pyramid;
+	buildDepthPyramid(depth, pyramid);
+	vector<Vec3f> projected, run;
+	vector< pair<float,float> > intervals;
+	for (size_t l = 0; l < lines.size(); l++) {
+		const Polylines &polylines = *lines[l];
+		if (polylines.points.empty()) continue;
+		projected.resize(polylines.points.size());
+		projectPoints(projection, &polylines.points[0], polylines.points.size(), &projected[0]);
+		svg.beginPath();
+		for (size_t i = 0; i < polylines.size(); i++) {
+			size_t first = polylines.first[i], n = polylines.count[i];
+			// the run continues while each segment is visible up to its end
+			bool open = false;
+			run.clear();
+			for (size_t j = first; j + 1 < first + n; j++) {
+				const Vec3f &a = projected[j], &b = projected[j+1];
+				intervals.clear();
+				visibleIntervals(pyramid, a, b, intervals);
+				if (intervals.empty()) open = false;
+				for (size_t k = 0; k < intervals.size(); k++) {
+					if (!open || intervals[k].first > 0) {
+						if (run.size() > 1) svg.polyline(&run[0], run.size());
+						run.clear();
+						run.push_back(a + intervals[k].first*(b-a));
+					}
+					run.push_back(a + intervals[k].second*(b-a));
+					open = intervals[k].second == 1;
+				}
+			}
+			if (run.size() > 1) svg.polyline(&run[0], run.size());
+		}
+		svg.endPath();
+	}
 
 	// -------------------------------------------------------------------------------------------------------------
 	
-	outfile << "</g>\n";
-	outfile << "</svg>\n";
+	svg.close();
+}
 
+void writeImage(Mesh &mesh, int width, int height, string filename, Vec3f camPos, const vector<const Polylines*> &lines) {
+	// Camera and depth are fetched from GL once; everything else is CPU side
+	ScreenProjection projection;
+	DepthImage depth;
+	getScreenProjection(projection);
+	readDepthImage(projection, depth);
+	writeImage(width, height, filename, projection, depth, lines);
 }
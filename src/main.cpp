@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cmath>
 #include <cstdio>
+#include <cctype>
 #include <stdlib.h>
 #include <GLUT/glut.h>
 #include <Eigen/Core>
@@ -14,6 +15,15 @@
 #include "image_generation.h"
 #include "decimate.h"
 #include "shader.h"
+#include "contours.h"
+#include "view_worker.h"
+#include "chaining.h"
+#include "mesh_buffers.h"
+#include "progressive_mesh.h"
+#include "parallel.h"
+#include "rasterizer.h"
+#include "mesh_cache.h"
+#include "tam_atlas.h"
 using namespace std;
 using namespace OpenMesh;
 using namespace Eigen;
@@ -29,14 +39,41 @@ double angleThresh = M_PI/4;
 double gradThresh = 1000.0;
 
 // Mesh properties
-VPropHandleT<double> viewCurvature;
-FPropHandleT<Vec3f> viewCurvatureDerivative;
-VPropHandleT<Vec3f> viewVecProjection;
 VPropHandleT<CurvatureInfo> curvature;
 VPropHandleT<Vec2f> textureCoord;
 
+// View-dependent state is computed off the GLUT thread
+ViewCurvatureCache viewCache;
+ViewWorker *viewWorker;
+
+// Levels of detail: mesh is the displayed level, previewMesh a coarse level
+// whose view-dependent state is used while the camera is moving
+ProgressiveMesh progressive;
+float detailFraction = 0.1f, previewFraction = 0.025f;
+Mesh previewMesh;
+VPropHandleT<CurvatureInfo> previewCurvature;
+ViewCurvatureCache previewCache;
+ViewWorker *previewWorker;
+ViewWorker *activeWorker; // the worker whose contours are drawn
+vector<unsigned int> previewIds, detailIds; // progressive mesh vertex of each mesh vertex
+size_t previewLevel;
+
+// Contours on the detail mesh are only searched near the preview mesh's
+AdaptiveContourMap adaptiveMap;
+bool adaptiveContours = true;
+
+// Preprocessed levels are kept in a mapped cache file next to the input
+MeshCache meshCache;
+string cacheFilename;
+bool useCache = true;
+
+// Feature edges
+FeatureEdgeCache featureEdges;
+vector<unsigned int> silhouetteLines;
+Polylines silhouettePolylines;
+
 Mesh mesh;
-vector<unsigned int> indices;
+MeshBuffers *meshBuffers = 0;
 vector<Vec2f> texCoords;
 void setTextureCoords();
 
@@ -47,6 +84,9 @@ Vec3f up, pan;
 int windowWidth = 640, windowHeight = 480;
 bool showSurface = true, showAxes = false, showCurvature = false, showContours = true, showNormals = false;
 string displayType = "smooth";
+bool parallelSimplify = false;
+const char *exportFilename = 0; // write this SVG without opening a window
+int exportViews = 1;            // number of turntable views to export
 
 // Light source attributes
 float specularLight[] = { 1.0, 1.0, 1.0, 1.0 };
@@ -66,79 +106,20 @@ GLuint hatchFrag;
 Shader* shader;
 
 // Texture images
-GLuint tamX3[2];    // stores highest detail tams   (256x256)
-GLuint tamX2[2];    // stores high detail tams      (128x128)
-GLuint tamX1[2];    // stores low detail tams       (64x64)
-GLuint tamX0[2];    // stores lowest detail tams    (32x32)
+GLuint tamX3[2];    // tones 0-2 and 3-5, each level of the mip chain a TAM resolution (256x256 down to 32x32)
+
+// Draws every polyline in one call
+void renderPolylines(const Polylines &lines) {
+    if (lines.size() == 0) return;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &lines.points[0]);
+    glMultiDrawArrays(GL_LINE_STRIP, &lines.first[0], &lines.count[0], lines.size());
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
 
-void renderSuggestiveContours(Vec3f actualCamPos) { // use this camera position to account for panning etc.
+void renderSuggestiveContours(const Polylines &contourLines) {
 	glColor3f(0.3,0.3,0.3);
-    glBegin(GL_LINES);
-    
-    Mesh::FaceIter f_it, f_end = mesh.faces_end();
-    Mesh::FaceVertexIter fv_it;
-    
-    for (f_it = mesh.faces_begin(); f_it != f_end; ++f_it) {
-        // Face data
-        Vec3f n = mesh.normal(f_it.handle());
-        Vec3f Dw = mesh.property(viewCurvatureDerivative,f_it);
-        
-        // Per-vertex data
-        fv_it = mesh.fv_iter(f_it.handle());
-        Vec3f p0 = mesh.point(fv_it.handle());
-        double kw0 = mesh.property(viewCurvature,fv_it);
-        Vec3f w0 = mesh.property(viewVecProjection,fv_it);
-        
-        Vec3f p1 = mesh.point((++fv_it).handle());
-        double kw1 = mesh.property(viewCurvature,fv_it);
-        Vec3f w1 = mesh.property(viewVecProjection,fv_it);
-        
-        Vec3f p2 = mesh.point((++fv_it).handle());
-        double kw2 = mesh.property(viewCurvature,fv_it);
-        Vec3f w2 = mesh.property(viewVecProjection,fv_it);
-        
-        // Centroid and view vector
-        Vec3f pC = (p0 + p1 + p2)/3;
-        Vec3f v = actualCamPos - pC;
-        v.normalize();
-        
-        // Skip face if normal is close to view vector
-        if (acos(dot(v,n)) < angleThresh) continue;
-        
-        // Skip face if Dwkw is small and positive
-        Vec3f wC = (w0 + w1 + w2)/3;    // take w to be the average of vertex w's
-        double dirGrad = -dot(Dw,wC);
-        if (dirGrad < 0 || (dirGrad > 0 && dirGrad < gradThresh)) continue;
-        
-        // EXTENSION (maybe): Ignore segments that are too short or uninteresting?
-        // EXTENSION (maybe): Reintroduce segments that were discarded, but next to a non-discarded segment
-        
-        // Determine if face has zero crossings
-        if ((kw0 > 0 && kw1 > 0 && kw2 > 0) || (kw0 < 0 && kw1 < 0 && kw2 < 0)) continue;
-        // Zero crossings along edges 0->2 and 1->2
-        if ((kw0 < 0 && kw1 < 0) || (kw0 > 0 && kw1 > 0)) {
-            // lerp
-            Vec3f v02 = p2*((0-kw0)/(kw2-kw0)) + p0*((kw2-0)/(kw2-kw0));
-            Vec3f v12 = p2*((0-kw1)/(kw2-kw1)) + p1*((kw2-0)/(kw2-kw1));
-            glVertex3f(v02[0],v02[1],v02[2]);
-            glVertex3f(v12[0],v12[1],v12[2]);
-        // Zero crossings along edges 0->1 and 1->2
-        } else if ((kw0 < 0 && kw2 < 0) || (kw0 > 0 && kw2 > 0)) {
-            // lerp
-            Vec3f v01 = p1*((0-kw0)/(kw1-kw0)) + p0*((kw1-0)/(kw1-kw0));
-            Vec3f v12 = p2*((0-kw1)/(kw2-kw1)) + p1*((kw2-0)/(kw2-kw1));
-            glVertex3f(v01[0],v01[1],v01[2]);
-            glVertex3f(v12[0],v12[1],v12[2]);
-        // Zero crossings along edges 0->1 and 0->2
-        } else if ((kw1 < 0 && kw2 < 0) || (kw1 > 0 && kw2 > 0)) {
-            // lerp
-            Vec3f v01 = p1*((0-kw0)/(kw1-kw0)) + p0*((kw1-0)/(kw1-kw0));
-            Vec3f v02 = p2*((0-kw0)/(kw2-kw0)) + p0*((kw2-0)/(kw2-kw0));
-            glVertex3f(v01[0],v01[1],v01[2]);
-            glVertex3f(v02[0],v02[1],v02[2]);
-        }
-    }
-    glEnd();
+    renderPolylines(contourLines);
 }
 
 void renderMesh() {
@@ -153,19 +134,8 @@ void renderMesh() {
 	glDepthRange(0.001,1);
 	glEnable(GL_NORMALIZE);
 	
-	// set up indices for array data
-    Mesh::ConstFaceIter f_end(mesh.faces_end());
-    Mesh::ConstFaceIter f_begin(mesh.faces_begin());
-    
-    indices.clear();
-    indices.reserve(mesh.n_faces()*3);
-    
-    for (Mesh::ConstFaceIter f_it = f_begin; f_it != f_end; ++f_it) {
-        Mesh::ConstFaceVertexIter fv_it = mesh.cfv_iter(f_it.handle());
-        indices.push_back(fv_it.handle().idx());
-        indices.push_back((++fv_it).handle().idx());
-        indices.push_back((++fv_it).handle().idx());
-    }
+	// upload the mesh once; later frames reuse the buffer objects
+	meshBuffers->update(mesh);
     
     // draw the mesh
 #ifndef HATCH_TEST
@@ -173,51 +143,36 @@ void renderMesh() {
         glEnable(GL_LIGHTING);
         glShadeModel(GL_SMOOTH);
         
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_NORMAL_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, mesh.points());
-        glNormalPointer(GL_FLOAT, 0, mesh.vertex_normals());
-        
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
-        
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_NORMAL_ARRAY);
+        meshBuffers->bind(true);
+        meshBuffers->draw();
+        meshBuffers->unbind();
     } else if (displayType == "wireframe") {
         glDisable(GL_LIGHTING);
         glColor3f(0.3, 0.3, 0.3);
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, mesh.points());
+        meshBuffers->bind(false);
+        meshBuffers->draw();
+        meshBuffers->unbind();
         
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
-        
-        glDisableClientState(GL_VERTEX_ARRAY);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     } else {
         glEnable(GL_LIGHTING);
         glShadeModel(GL_FLAT);
         
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_NORMAL_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, mesh.points());
-        glNormalPointer(GL_FLOAT, 0, mesh.vertex_normals());
-        
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
+        meshBuffers->bind(true);
+        meshBuffers->draw();
+        meshBuffers->unbind();
         
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_NORMAL_ARRAY);
         if (displayType == "flatwire") {
             glDisable(GL_LIGHTING);
             glColor3f(0.3, 0.3, 0.3);
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
             
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glVertexPointer(3, GL_FLOAT, 0, mesh.points());
-            
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
+            meshBuffers->bind(false);
+            meshBuffers->draw();
+            meshBuffers->unbind();
             
-            glDisableClientState(GL_VERTEX_ARRAY);
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
     }
@@ -234,22 +189,19 @@ void renderMesh() {
 	Vec3f actualCamPos(cameraPos[0]+pan[0],cameraPos[1]+pan[1],cameraPos[2]+pan[2]);
 
     if (showContours)
-        renderSuggestiveContours(actualCamPos);
+        renderSuggestiveContours(activeWorker->front().contourLines);
     
-	// We'll be nice and provide you with code to render feature edges below
-	glBegin(GL_LINES);
+	// Feature edges: boundary and sharp edges come from the cache, only the
+	// silhouettes are searched for this view
+	if (!featureEdges.valid) buildFeatureEdgeCache(mesh,featureEdges);
+	silhouetteLines.clear();
+	findSilhouettes(mesh,featureEdges,actualCamPos,silhouetteLines);
+	chainLines(mesh,silhouetteLines,silhouettePolylines);
+	
 	glColor3f(0,0,0);
 	glLineWidth(2.0f);
-	for (Mesh::ConstEdgeIter it = mesh.edges_begin(); it != mesh.edges_end(); ++it)
-		if (isFeatureEdge(mesh,*it,actualCamPos)) {
-			Mesh::HalfedgeHandle h0 = mesh.halfedge_handle(it,0);
-			Mesh::HalfedgeHandle h1 = mesh.halfedge_handle(it,1);
-			Vec3f source(mesh.point(mesh.from_vertex_handle(h0)));
-			Vec3f target(mesh.point(mesh.from_vertex_handle(h1)));
-			glVertex3f(source[0],source[1],source[2]);
-			glVertex3f(target[0],target[1],target[2]);
-		}
-	glEnd();
+	renderPolylines(featureEdges.staticPolylines);
+	renderPolylines(silhouettePolylines);
 	
 	if (showCurvature) {
 		glBegin(GL_LINES);
@@ -305,12 +257,15 @@ void renderMesh() {
     // Vertices
     GLint position = glGetAttribLocation(hatchProg, "positionIn");
     glEnableVertexAttribArray(position);
-    glVertexAttribPointer(position, 3, GL_FLOAT, 0, 0, mesh.points());
+    glBindBuffer(GL_ARRAY_BUFFER, meshBuffers->positionBuffer());
+    glVertexAttribPointer(position, 3, GL_FLOAT, 0, 0, 0);
 	
     // Normals
     GLint normal = glGetAttribLocation(hatchProg, "normalIn");
     glEnableVertexAttribArray(normal);
-    glVertexAttribPointer(normal, 3, GL_FLOAT, 0, 0, mesh.vertex_normals());
+    glBindBuffer(GL_ARRAY_BUFFER, meshBuffers->normalBuffer());
+    glVertexAttribPointer(normal, 3, GL_FLOAT, 0, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     
     // Texture coords
     GLint texcoord = glGetAttribLocation(hatchProg, "texcoordIn");
@@ -328,7 +283,9 @@ void renderMesh() {
     handle = glGetUniformLocation(hatchProg, "hatch345");
     glUniform1i(handle, 1);
     
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshBuffers->indexBuffer());
+    meshBuffers->draw();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 #endif
 }
 
@@ -345,77 +302,36 @@ void loadShaders() {
     //delete shader;
 }
 
+// Loads the packed TAM atlas written by packTam, or packs the BMPs if there
+// is none
 void loadTextures() {
-    glGenTextures(2, tamX3);
-    
-    sf::Image image0 = sf::Image();
-    image0.loadFromFile("textures/tam03.bmp");
-    sf::Vector2u size = image0.getSize();
-    GLuint width = size.x;
-    GLuint height = size.y;
-    sf::Image image1 = sf::Image();
-    image1.loadFromFile("textures/tam13.bmp");
-    sf::Image image2 = sf::Image();
-    image2.loadFromFile("textures/tam23.bmp");
-    sf::Image texture1 = sf::Image(); // stores 3 textures in r, g, and b
-    texture1.create(width,height);
-    
-    // set three grayscale images to R, G, and B values of texture1
-    sf::Color p0, p1, p2;
-    for (GLuint x = 0; x < width; x++) {
-        for (GLuint y = 0; y < height; y++) {
-            p0 = image0.getPixel(x,y);
-            p1 = image1.getPixel(x,y);
-            p2 = image2.getPixel(x,y);
-            GLuint r = (p0.r + p0.g + p0.b)/3;
-            GLuint g = (p1.r + p1.g + p1.b)/3;
-            GLuint b = (p2.r + p2.g + p2.b)/3;
-            texture1.setPixel(x,y,sf::Color(r,g,b,255));
+    TamAtlas atlas;
+    if (!readTamAtlas("textures/tam.atlas", atlas)) {
+        cout << "No textures/tam.atlas, packing the TAM images (run packTam to skip this).\n";
+        if (!packTamAtlas("textures", atlas)) {
+            cout << "Could not read the TAM images.\n";
+            return;
         }
     }
     
-    // tones 1, 2, and 3 (r, g, and b)
-    glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, tamX3[0]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texture1.getPixelsPtr());
-    //glTexImage2D(GL_TEXTURE_2D, 0, 4, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture1.getPixelsPtr());
-
-    sf::Image image3 = sf::Image();
-    image3.loadFromFile("textures/tam33.bmp");
-    sf::Image image4 = sf::Image();
-    image4.loadFromFile("textures/tam43.bmp");
-    sf::Image image5 = sf::Image();
-    image5.loadFromFile("textures/tam53.bmp");
-    sf::Image texture2 = sf::Image(); // stores 3 textures in r, g, and b
-    texture2.create(width,height);
-
-    // set three grayscale images to R, G, and B values of texture2
-    sf::Color p3, p4, p5;
-    for (GLuint x = 0; x < width; x++) {
-        for (GLuint y = 0; y < height; y++) {
-            p3 = image3.getPixel(x,y);
-            p4 = image4.getPixel(x,y);
-            p5 = image5.getPixel(x,y);
-            GLuint r = (p3.r + p3.g + p3.b)/3;
-            GLuint g = (p4.r + p4.g + p4.b)/3;
-            GLuint b = (p5.r + p5.g + p5.b)/3;
-            texture2.setPixel(x,y,sf::Color(r,g,b,255));
+    glGenTextures(2, tamX3);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int t = 0; t < 2; t++) {
+        // tones 3t, 3t+1 and 3t+2 (r, g, and b)
+        glActiveTexture(GL_TEXTURE0 + t);
+        glBindTexture(GL_TEXTURE_2D, tamX3[t]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // the chain ends at the smallest TAM image
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlas.levels-1);
+        for (int l = 0; l < atlas.levels; l++) {
+            int size = atlas.size >> l;
+            glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.level(t, l));
         }
     }
-
-    // tones 4, 5, and 6 (r, g, and b)
-    glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, tamX3[1]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texture2.getPixelsPtr());
-    //glTexImage2D(GL_TEXTURE_2D, 1, 4, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture2.getPixelsPtr());
     
     glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, tamX3[0]);
@@ -533,6 +449,170 @@ void display() {
 	glutSwapBuffers();
 }
 
+// Recomputes everything derived from the displayed mesh after its level of
+// detail changed.  The view worker must be stopped.  Returns whether the
+// normals and curvature came from the cache.
+bool prepareDetailMesh() {
+	bool cached = meshCache.loadLevel(progressive.numVertices(),mesh,curvature);
+	if (!cached) {
+		mesh.update_normals();
+		computeCurvature(mesh,curvature);
+	}
+	buildViewCurvatureCache(mesh,curvature,viewCache);
+	buildAdaptiveContourMap(progressive,previewLevel,previewMesh,previewIds,previewCache,detailIds,viewCache,adaptiveMap);
+	buildFeatureEdgeCache(mesh,featureEdges);
+	if (meshBuffers) meshBuffers->invalidate();
+#ifdef HATCH_TEST
+	setTextureCoords();
+#endif
+	return cached;
+}
+
+// Switches the displayed mesh to the given fraction of the input vertices
+void setDetailLevel(float fraction) {
+	detailFraction = max(previewFraction, min(1.0f, fraction));
+	viewWorker->stop();
+	progressive.setNumVertices((size_t)(detailFraction * progressive.maxVertices()));
+	progressive.extract(mesh,&detailIds);
+	prepareDetailMesh();
+	viewWorker->start();
+	cout << "Detail level: " << mesh.n_vertices() << " vertices.\n";
+}
+
+// Ask the view worker for the current camera and thresholds.  Stale requests
+// are dropped by the worker, so this is cheap to call on every event.  While
+// a mouse button is held the camera is moving and the coarse preview is
+// enough; the full level is requested once the button is released.
+void updateView() {
+	ViewRequest request;
+	request.camPos = Vec3f(cameraPos[0]+pan[0],cameraPos[1]+pan[1],cameraPos[2]+pan[2]);
+	request.angleThresh = angleThresh;
+	request.gradThresh = gradThresh;
+	request.adaptive = adaptiveContours;
+	activeWorker = (leftDown || rightDown || middleDown) ? previewWorker : viewWorker;
+	activeWorker->request(request);
+}
+
+// Work space of exportImage, one per thread
+struct ExportScratch {
+	ViewState state;
+	vector<unsigned int> silhouetteLines;
+	Polylines silhouettePolylines;
+	DepthImage depth;
+};
+
+// Writes the line drawing seen by camera without a GL context: the depth
+// buffer comes from the software rasterizer and the view-dependent state
+// is computed on the calling thread
+void exportImage(const Camera &camera, const string &filename, ExportScratch &scratch) {
+	ScreenProjection projection;
+	cameraProjection(camera, projection);
+	rasterizeDepth(mesh, projection, scratch.depth);
+
+	ViewRequest request;
+	request.camPos = camera.eye;
+	request.angleThresh = angleThresh;
+	request.gradThresh = gradThresh;
+	// exports are final output, so search every face rather than only
+	// those the preview level selects
+	request.adaptive = false;
+	computeViewState(mesh, viewCache, request, scratch.state);
+
+	scratch.silhouetteLines.clear();
+	findSilhouettes(mesh,featureEdges,camera.eye,scratch.silhouetteLines);
+	chainLines(mesh,scratch.silhouetteLines,scratch.silhouettePolylines);
+
+	vector<const Polylines*> lines;
+	lines.push_back(&featureEdges.staticPolylines);
+	lines.push_back(&scratch.silhouettePolylines);
+	lines.push_back(&scratch.state.contourLines);
+	writeImage(camera.width, camera.height, filename, projection, scratch.depth, lines);
+}
+
+// Writes i into name at least width digits wide, padded with fill
+static void appendNumber(string &name, int i, int width, char fill) {
+	string digits;
+	do {
+		digits.insert(digits.begin(), (char)('0' + i % 10));
+		i /= 10;
+	} while (i > 0);
+	if ((int)digits.size() < width) name.append(width - digits.size(), fill);
+	name += digits;
+}
+
+// Name of view i of an export: pattern itself for a single view.  Otherwise
+// a single %d, %Nd or %0Nd in pattern is replaced by the view number (with
+// %% standing for %); a pattern without exactly one such field gets _NNN
+// added before its extension.  The pattern is never used as a printf format.
+string exportName(const char *pattern, int i, int views) {
+	string name(pattern);
+	if (views == 1) return name;
+
+	string formatted;
+	int fields = 0;
+	bool valid = true;
+	for (size_t c = 0; c < name.size() && valid; c++) {
+		if (name[c] != '%') {
+			formatted += name[c];
+			continue;
+		}
+		if (c+1 < name.size() && name[c+1] == '%') {
+			formatted += '%';
+			c++;
+			continue;
+		}
+		size_t d = c+1;
+		char fill = d < name.size() && name[d] == '0' ? '0' : ' ';
+		int width = 0;
+		while (d < name.size() && isdigit((unsigned char)name[d]) && width < 100) width = 10*width + (name[d++] - '0');
+		if (d >= name.size() || name[d] != 'd' || ++fields > 1) valid = false;
+		else appendNumber(formatted, i, width, fill);
+		c = d;
+	}
+	if (valid && fields == 1) return formatted;
+
+	size_t dot = name.rfind('.');
+	if (dot == string::npos || name.find('/', dot) != string::npos) dot = name.size();
+	string numbered = name.substr(0, dot) + '_';
+	appendNumber(numbered, i, 3, '0');
+	return numbered + name.substr(dot);
+}
+
+// Exports views images of a turntable around the up axis, starting at the
+// default view.  The mesh is preprocessed once; views are spread over the
+// threads, each rendering whole views.
+void exportImages(const char *pattern, int views) {
+	Vec3f eye(cameraPos[0]+pan[0],cameraPos[1]+pan[1],cameraPos[2]+pan[2]);
+	Vec3f axis = up.normalized(), offset = eye - pan;
+	vector<Camera> cameras(views);
+	for (int i = 0; i < views; i++) {
+		// rotate the offset from the target about the axis
+		float angle = 2*M_PI*i/views;
+		Vec3f rotated = offset*cos(angle) + (axis % offset)*sin(angle) + axis*dot(axis,offset)*(1-cos(angle));
+		cameras[i].eye = pan + rotated;
+		cameras[i].center = pan;
+		cameras[i].up = up;
+		cameras[i].width = windowWidth;
+		cameras[i].height = windowHeight;
+	}
+
+	vector<ExportScratch> scratch(parallelChunks(views, 1));
+	parallelForDynamic(0, views, [&](size_t begin, size_t end, int worker) {
+		for (size_t i = begin; i < end; i++)
+			exportImage(cameras[i], exportName(pattern, (int)i, views), scratch[worker]);
+	});
+	if (views == 1) cout << "Wrote " << pattern << endl;
+	else cout << "Wrote " << views << " views to " << exportName(pattern, 0, views) << "...\n";
+}
+
+// Redraw whenever a view worker has finished a newer result
+void pollViewWorker(int) {
+	bool fresh = viewWorker->acquire();
+	fresh = previewWorker->acquire() || fresh;
+	if (fresh) glutPostRedisplay();
+	glutTimerFunc(10, pollViewWorker, 0);
+}
+
 void mouse(int button, int state, int x, int y) {
 	if (button == GLUT_LEFT_BUTTON) leftDown = (state == GLUT_DOWN);
 	else if (button == GLUT_RIGHT_BUTTON) rightDown = (state == GLUT_DOWN);
@@ -540,6 +620,9 @@ void mouse(int button, int state, int x, int y) {
 	
 	lastPos[0] = x;
 	lastPos[1] = y;
+	
+	// camera settled: back to full detail
+	if (state == GLUT_UP) updateView();
 }
 
 void mouseMoved(int x, int y) {
@@ -568,8 +651,7 @@ void mouseMoved(int x, int y) {
 	lastPos[0] = x;
 	lastPos[1] = y;
 	
-	Vec3f actualCamPos(cameraPos[0]+pan[0],cameraPos[1]+pan[1],cameraPos[2]+pan[2]);
-	computeViewCurvature(mesh,actualCamPos,curvature,viewCurvature,viewCurvatureDerivative, viewVecProjection);
+	updateView();
 	
 	glutPostRedisplay();
 }
@@ -581,6 +663,7 @@ void keyboardSpec(int key, int x, int y) {
     else if (key == GLUT_KEY_UP) gradThresh *= 10./9.;
     cout << "angleThresh: " << angleThresh << endl;
     cout << "gradThresh: " << gradThresh << endl << endl;
+	updateView();
 	glutPostRedisplay();
 }
 
@@ -598,8 +681,31 @@ void keyboard(unsigned char key, int x, int y) {
         else if (displayType == "flat") displayType = "flatwire";
         else if (displayType == "flatwire") displayType = "wireframe";
     }
-	else if (key == 'w' || key == 'W') writeImage(mesh, windowWidth, windowHeight, "renderedImage.svg", actualCamPos);
-	else if (key == 'q' || key == 'Q') exit(0);
+	else if (key == 'w' || key == 'W') {
+		vector<const Polylines*> lines;
+		lines.push_back(&featureEdges.staticPolylines);
+		lines.push_back(&silhouettePolylines);
+		if (showContours) lines.push_back(&viewWorker->front().contourLines);
+		writeImage(mesh, windowWidth, windowHeight, "renderedImage.svg", actualCamPos, lines);
+	}
+	else if (key == '+' || key == '=') {
+		setDetailLevel(detailFraction * 2);
+		updateView();
+	}
+	else if (key == '-' || key == '_') {
+		setDetailLevel(detailFraction / 2);
+		updateView();
+	}
+	else if (key == 'r' || key == 'R') {
+		adaptiveContours = !adaptiveContours;
+		cout << "Adaptive contours: " << (adaptiveContours ? "on" : "off") << endl;
+		updateView();
+	}
+	else if (key == 'q' || key == 'Q') {
+		viewWorker->stop();
+		previewWorker->stop();
+		exit(0);
+	}
 	glutPostRedisplay();
 }
 
@@ -609,11 +715,45 @@ void reshape(int width, int height) {
 	glutPostRedisplay();
 }
 
+void usage(const char *program) {
+	cout << "Usage: " << program << " [-t threads] [-a angle] [-p] [-l fraction] [-c cache | -C] [-o file.svg [-s WxH] [-n views]] mesh_filename\n";
+	cout << "\t-t threads\tworker threads for preprocessing (default: one per core)\n";
+	cout << "\t-p\t\tsimplify in parallel rounds instead of strict cost order\n";
+	cout << "\t-l fraction\tinitial fraction of the vertices to display, +/- change it (default: " << detailFraction << ")\n";
+	cout << "\t-c cache\tpreprocessed mesh cache file (default: mesh_filename.cache)\n";
+	cout << "\t-C\t\tneither read nor write the cache\n";
+	cout << "\t-o file.svg\twrite the line drawing of the default view and exit, without a display\n";
+	cout << "\t-s WxH\t\timage size for -o (default: " << windowWidth << 'x' << windowHeight << ")\n";
+	cout << "\t-n views\twith -o, export a turntable of this many views around the up axis,\n\t\t\tnumbered at a %d (or %0Nd) in the file name, else before its extension\n";
+	cout << "\t-a angle\tdihedral angle in degrees above which an edge is sharp (default: " << DEFAULT_SHARP_ANGLE << ")\n";
+	exit(0);
+}
+
 int main(int argc, char** argv) {
-	if (argc < 2) {
-		cout << "Usage: " << argv[0] << " mesh_filename\n";
-		exit(0);
+	int c;
+	while ((c = getopt(argc, argv, "t:a:pl:o:s:n:c:C")) != -1) {
+		if (c == 't') setNumThreads(atoi(optarg));
+		else if (c == 'a') featureEdges.sharpAngle = atof(optarg);
+		else if (c == 'p') parallelSimplify = true;
+		else if (c == 'l') {
+			char *end;
+			detailFraction = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || !(detailFraction > 0 && detailFraction <= 1)) usage(argv[0]);
+		}
+		else if (c == 'o') exportFilename = optarg;
+		else if (c == 'c') cacheFilename = optarg;
+		else if (c == 'C') useCache = false;
+		else if (c == 'n') {
+			exportViews = atoi(optarg);
+			if (exportViews < 1) usage(argv[0]);
+		}
+		else if (c == 's') {
+			if (sscanf(optarg, "%dx%d", &windowWidth, &windowHeight) != 2 || windowWidth <= 0 || windowHeight <= 0) usage(argv[0]);
+		}
+		else usage(argv[0]);
 	}
+	if (optind >= argc) usage(argv[0]);
+	const char *meshFilename = argv[optind];
 	
 	IO::Options opt;
 	opt += IO::Options::VertexNormal;
@@ -623,50 +763,99 @@ int main(int argc, char** argv) {
 	mesh.request_vertex_normals();
     mesh.request_vertex_texcoords2D();
 	
-	cout << "Reading from file " << argv[1] << "...\n";
-	if ( !IO::read_mesh(mesh, argv[1], opt )) {
-		cout << "Read failed.\n";
-		exit(0);
+	// The cache holds everything up to the curvature of the preview and
+	// detail levels, for this file and decimation ratio
+	previewFraction = min(previewFraction, detailFraction);
+	MeshCacheKey cacheKey;
+	cacheKey.baseFraction = previewFraction;
+	cacheKey.parallel = parallelSimplify;
+	if (cacheFilename.empty()) cacheFilename = string(meshFilename) + ".cache";
+	bool hashed = useCache && hashFile(meshFilename,cacheKey.fileHash);
+	if (hashed && meshCache.open(cacheFilename,cacheKey)) {
+		cout << "Reading preprocessed mesh from " << cacheFilename << "...\n";
+		meshCache.loadProgressive(progressive);
 	}
+	else {
+		cout << "Reading from file " << meshFilename << "...\n";
+		if ( !IO::read_mesh(mesh, meshFilename, opt )) {
+			cout << "Read failed.\n";
+			exit(0);
+		}
 
-	cout << "Mesh stats:\n";
-	cout << '\t' << mesh.n_vertices() << " vertices.\n";
-	cout << '\t' << mesh.n_edges() << " edges.\n";
-	cout << '\t' << mesh.n_faces() << " faces.\n";
+		cout << "Mesh stats:\n";
+		cout << '\t' << mesh.n_vertices() << " vertices.\n";
+		cout << '\t' << mesh.n_edges() << " edges.\n";
+		cout << '\t' << mesh.n_faces() << " faces.\n";
 	
-	simplify(mesh,0.1f);
+		// Move center of mass to origin
+		Vec3f center(0,0,0);
+		for (Mesh::ConstVertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) center += mesh.point(vIt);
+		center /= mesh.n_vertices();
+		for (Mesh::VertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) mesh.point(vIt) -= center;
+
+		// Fit in the unit sphere
+		float maxLength = 0;
+		for (Mesh::ConstVertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) maxLength = max(maxLength, mesh.point(vIt).length());
+		for (Mesh::VertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) mesh.point(vIt) /= maxLength;
 	
-	mesh.update_normals();
+		// Record the decimation once; every level down to the preview is then
+		// available without simplifying again
+		progressive.build(mesh,previewFraction,parallelSimplify);
+	}
+	
+	previewMesh.request_face_normals();
+	previewMesh.request_vertex_normals();
+	previewMesh.add_property(previewCurvature);
+	progressive.setNumVertices((size_t)(previewFraction * progressive.maxVertices()));
+	previewLevel = progressive.numVertices();
+	progressive.extract(previewMesh,&previewIds);
+	bool cachedPreview = meshCache.loadLevel(previewLevel,previewMesh,previewCurvature);
+	if (!cachedPreview) {
+		previewMesh.update_normals();
+		computeCurvature(previewMesh,previewCurvature);
+	}
+	buildViewCurvatureCache(previewMesh,previewCurvature,previewCache);
 	
-	mesh.add_property(viewCurvature);
-	mesh.add_property(viewCurvatureDerivative);
-    mesh.add_property(viewVecProjection);
 	mesh.add_property(curvature);
     mesh.add_property(textureCoord);
-	
-	// Move center of mass to origin
-	Vec3f center(0,0,0);
-	for (Mesh::ConstVertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) center += mesh.point(vIt);
-	center /= mesh.n_vertices();
-	for (Mesh::VertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) mesh.point(vIt) -= center;
-
-	// Fit in the unit sphere
-	float maxLength = 0;
-	for (Mesh::ConstVertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) maxLength = max(maxLength, mesh.point(vIt).length());
-	for (Mesh::VertexIter vIt = mesh.vertices_begin(); vIt != mesh.vertices_end(); ++vIt) mesh.point(vIt) /= maxLength;
-	
-	computeCurvature(mesh,curvature);
+	progressive.setNumVertices((size_t)(detailFraction * progressive.maxVertices()));
+	progressive.extract(mesh,&detailIds);
+	bool cachedDetail = prepareDetailMesh();
+
+	// Store what had to be computed for the next launch
+	if (hashed && (!cachedPreview || !cachedDetail)) {
+		vector<MeshCacheLevel> levels(2);
+		levels[0].level = previewLevel;
+		levels[0].mesh = &previewMesh;
+		levels[0].curvature = &previewCurvature;
+		levels[1].level = progressive.numVertices();
+		levels[1].mesh = &mesh;
+		levels[1].curvature = &curvature;
+		meshCache.close();
+		if (writeMeshCache(cacheFilename,cacheKey,progressive,levels)) cout << "Wrote preprocessed mesh to " << cacheFilename << endl;
+		meshCache.open(cacheFilename,cacheKey);
+	}
 
 	up = Vec3f(0,1,0);
 	pan = Vec3f(0,0,0);
+
+	if (exportFilename) {
+		exportImages(exportFilename, exportViews);
+		return 0;
+	}
 	
-	Vec3f actualCamPos(cameraPos[0]+pan[0],cameraPos[1]+pan[1],cameraPos[2]+pan[2]);
-	computeViewCurvature(mesh,actualCamPos,curvature,viewCurvature,viewCurvatureDerivative,viewVecProjection);
+	viewWorker = new ViewWorker(mesh,viewCache);
+	viewWorker->setAdaptiveMap(&adaptiveMap);
+	viewWorker->start();
+	previewWorker = new ViewWorker(previewMesh,previewCache);
+	previewWorker->start();
+	updateView();
 
 	glutInit(&argc, argv); 
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH); 
 	glutInitWindowSize(windowWidth, windowHeight); 
 	glutCreateWindow(argv[0]);
+	meshBuffers = new MeshBuffers();
     
 #ifdef HATCH_TEST
     // Load vertex/frag shaders and textures
@@ -681,6 +870,7 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(reshape);
 	glutKeyboardFunc(keyboard);
     glutSpecialFunc(keyboardSpec);
+	glutTimerFunc(10, pollViewWorker, 0);
 
 	glutMainLoop();
 	
@@ -0,0 +1,86 @@
+#include "mesh_buffers.h"
+#include <vector>
+
+MeshBuffers::MeshBuffers() :
+	positionBuffer_(0),
+	normalBuffer_(0),
+	indexBuffer_(0),
+	indexCount_(0),
+	dirty_(true) {
+}
+
+MeshBuffers::~MeshBuffers() {
+	if (positionBuffer_) glDeleteBuffers(1, &positionBuffer_);
+	if (normalBuffer_) glDeleteBuffers(1, &normalBuffer_);
+	if (indexBuffer_) glDeleteBuffers(1, &indexBuffer_);
+}
+
+void MeshBuffers::update(const Mesh& mesh) {
+	if (!dirty_) return;
+	if (!positionBuffer_) glGenBuffers(1, &positionBuffer_);
+	if (!normalBuffer_) glGenBuffers(1, &normalBuffer_);
+	if (!indexBuffer_) glGenBuffers(1, &indexBuffer_);
+	
+	// set up indices for array data
+	std::vector<GLuint> indices;
+	indices.reserve(mesh.n_faces()*3);
+	for (Mesh::ConstFaceIter f_it = mesh.faces_begin(); f_it != mesh.faces_end(); ++f_it) {
+		Mesh::ConstFaceVertexIter fv_it = mesh.cfv_iter(f_it.handle());
+		indices.push_back(fv_it.handle().idx());
+		indices.push_back((++fv_it).handle().idx());
+		indices.push_back((++fv_it).handle().idx());
+	}
+	indexCount_ = indices.size();
+	
+	GLsizeiptr vertexBytes = mesh.n_vertices()*sizeof(Mesh::Point);
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer_);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.points(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, normalBuffer_);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.vertex_normals(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount_*sizeof(GLuint), indices.empty() ? 0 : &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	
+	dirty_ = false;
+}
+
+void MeshBuffers::invalidate() {
+	dirty_ = true;
+}
+
+void MeshBuffers::bind(bool normals) const {
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer_);
+	glVertexPointer(3, GL_FLOAT, 0, 0);
+	if (normals) {
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer_);
+		glNormalPointer(GL_FLOAT, 0, 0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+}
+
+void MeshBuffers::unbind() const {
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+}
+
+void MeshBuffers::draw() const {
+	glDrawElements(GL_TRIANGLES, indexCount_, GL_UNSIGNED_INT, 0);
+}
+
+GLuint MeshBuffers::positionBuffer() const {
+	return positionBuffer_;
+}
+
+GLuint MeshBuffers::normalBuffer() const {
+	return normalBuffer_;
+}
+
+GLuint MeshBuffers::indexBuffer() const {
+	return indexBuffer_;
+}
@@ -0,0 +1,255 @@
+#include "mesh_cache.h"
+#include <cstdio>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace OpenMesh;
+using namespace std;
+
+// Bump whenever the layout below changes
+static const uint32_t CACHE_VERSION = 1;
+static const char CACHE_MAGIC[8] = { 'M','E','S','H','C','A','C','H' };
+// every array starts at a multiple of this
+static const size_t CACHE_ALIGN = 16;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t pointSize, splitSize, curvatureSize;   // guard against other builds
+	uint64_t fileHash;
+	float baseFraction;
+	uint32_t parallel;
+	uint64_t nPoints, nFaces, nSplits, nCorners, nLevels;
+};
+
+struct CacheLevelHeader {
+	uint64_t level, nVertices, nFaces;
+};
+
+// Maps filename read-only; the caller unmaps
+static void* mapFile(const string &filename, size_t &size) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return 0;
+	struct stat st;
+	void *data = 0;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		size = (size_t)st.st_size;
+		data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) data = 0;
+	}
+	::close(fd);
+	return data;
+}
+
+bool hashFile(const string &filename, uint64_t &hash) {
+	size_t size = 0;
+	void *data = mapFile(filename, size);
+	if (!data) return false;
+	const unsigned char *p = (const unsigned char*)data;
+	hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	munmap(data, size);
+	return true;
+}
+
+// Appends arrays to a file, padding each to CACHE_ALIGN
+class CacheFileWriter {
+public:
+	CacheFileWriter(FILE *file) : file_(file), offset_(0), ok_(true) {}
+
+	void write(const void *data, size_t bytes) {
+		static const char zeros[CACHE_ALIGN] = { 0 };
+		if (bytes && fwrite(data, 1, bytes, file_) != bytes) ok_ = false;
+		offset_ += bytes;
+		size_t pad = (CACHE_ALIGN - offset_ % CACHE_ALIGN) % CACHE_ALIGN;
+		if (pad && fwrite(zeros, 1, pad, file_) != pad) ok_ = false;
+		offset_ += pad;
+	}
+	bool ok() const { return ok_; }
+
+private:
+	FILE *file_;
+	size_t offset_;
+	bool ok_;
+};
+
+bool writeMeshCache(const string &filename, const MeshCacheKey &key, ProgressiveMesh &progressive, const vector<MeshCacheLevel> &levels) {
+	// write next to the target and rename, so a reader never sees half a file
+	string temporary = filename + ".tmp";
+	FILE *file = fopen(temporary.c_str(), "wb");
+	if (!file) return false;
+
+	size_t current = progressive.numVertices();
+	progressive.setNumVertices(progressive.maxVertices());
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.pointSize = sizeof(Mesh::Point);
+	header.splitSize = sizeof(VertexSplit);
+	header.curvatureSize = sizeof(CurvatureInfo);
+	header.fileHash = key.fileHash;
+	header.baseFraction = key.baseFraction;
+	header.parallel = key.parallel;
+	header.nPoints = progressive.points().size();
+	header.nFaces = progressive.indices().size()/3;
+	header.nSplits = progressive.splits().size();
+	header.nCorners = progressive.corners().size();
+	header.nLevels = levels.size();
+
+	CacheFileWriter writer(file);
+	writer.write(&header, sizeof(header));
+	writer.write(&progressive.points()[0], header.nPoints*sizeof(Mesh::Point));
+	writer.write(&progressive.indices()[0], 3*header.nFaces*sizeof(unsigned int));
+	if (header.nSplits) writer.write(&progressive.splits()[0], header.nSplits*sizeof(VertexSplit));
+	if (header.nCorners) writer.write(&progressive.corners()[0], header.nCorners*sizeof(unsigned int));
+	writer.write(&progressive.faceCounts()[0], (header.nSplits+1)*sizeof(unsigned int));
+	progressive.setNumVertices(current);
+
+	vector<Vec3f> normals;
+	vector<CurvatureInfo> curvature;
+	for (size_t l = 0; l < levels.size(); l++) {
+		const Mesh &mesh = *levels[l].mesh;
+		CacheLevelHeader level = { levels[l].level, mesh.n_vertices(), mesh.n_faces() };
+		writer.write(&level, sizeof(level));
+
+		normals.resize(mesh.n_vertices());
+		curvature.resize(mesh.n_vertices());
+		for (size_t v = 0; v < mesh.n_vertices(); v++) {
+			Mesh::VertexHandle vh((int)v);
+			normals[v] = mesh.normal(vh);
+			curvature[v] = mesh.property(*levels[l].curvature, vh);
+		}
+		writer.write(normals.empty() ? 0 : &normals[0], normals.size()*sizeof(Vec3f));
+
+		normals.resize(mesh.n_faces());
+		for (size_t f = 0; f < mesh.n_faces(); f++) normals[f] = mesh.normal(Mesh::FaceHandle((int)f));
+		writer.write(normals.empty() ? 0 : &normals[0], normals.size()*sizeof(Vec3f));
+		writer.write(curvature.empty() ? 0 : &curvature[0], curvature.size()*sizeof(CurvatureInfo));
+	}
+
+	bool ok = writer.ok();
+	ok = fclose(file) == 0 && ok;
+	ok = ok && rename(temporary.c_str(), filename.c_str()) == 0;
+	if (!ok) remove(temporary.c_str());
+	return ok;
+}
+
+// Hands out consecutive aligned arrays of a mapped file, failing once the
+// file is too short
+class CacheFileReader {
+public:
+	CacheFileReader(const void *data, size_t size) : data_((const char*)data), size_(size), offset_(0), ok_(true) {}
+
+	const void* read(size_t bytes) {
+		if (!ok_ || bytes > size_ - offset_) {
+			ok_ = false;
+			return 0;
+		}
+		const void *p = data_ + offset_;
+		offset_ += bytes;
+		offset_ = min(size_, offset_ + (CACHE_ALIGN - offset_ % CACHE_ALIGN) % CACHE_ALIGN);
+		return p;
+	}
+	bool ok() const { return ok_; }
+
+private:
+	const char *data_;
+	size_t size_, offset_;
+	bool ok_;
+};
+
+MeshCache::MeshCache() : data_(0), size_(0), points_(0), indices_(0), corners_(0), faceCount_(0), splits_(0),
+						 nPoints_(0), nFaces_(0), nSplits_(0), nCorners_(0) {
+}
+
+MeshCache::~MeshCache() {
+	close();
+}
+
+bool MeshCache::open(const string &filename, const MeshCacheKey &key) {
+	close();
+	data_ = mapFile(filename, size_);
+	if (!data_) return false;
+
+	CacheFileReader reader(data_, size_);
+	const CacheHeader *header = (const CacheHeader*)reader.read(sizeof(CacheHeader));
+	if (!header || memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != CACHE_VERSION ||
+		header->pointSize != sizeof(Mesh::Point) || header->splitSize != sizeof(VertexSplit) ||
+		header->curvatureSize != sizeof(CurvatureInfo) || header->fileHash != key.fileHash ||
+		header->baseFraction != key.baseFraction || header->parallel != key.parallel) {
+		close();
+		return false;
+	}
+
+	// counts beyond the file size would overflow the byte counts below
+	if (header->nPoints > size_ || header->nFaces > size_ || header->nSplits > size_ || header->nCorners > size_) {
+		close();
+		return false;
+	}
+	nPoints_ = header->nPoints;
+	nFaces_ = header->nFaces;
+	nSplits_ = header->nSplits;
+	nCorners_ = header->nCorners;
+	points_ = (const Mesh::Point*)reader.read(nPoints_*sizeof(Mesh::Point));
+	indices_ = (const unsigned int*)reader.read(3*nFaces_*sizeof(unsigned int));
+	splits_ = (const VertexSplit*)reader.read(nSplits_*sizeof(VertexSplit));
+	corners_ = (const unsigned int*)reader.read(nCorners_*sizeof(unsigned int));
+	faceCount_ = (const unsigned int*)reader.read((nSplits_+1)*sizeof(unsigned int));
+	for (uint64_t l = 0; l < header->nLevels; l++) {
+		const CacheLevelHeader *levelHeader = (const CacheLevelHeader*)reader.read(sizeof(CacheLevelHeader));
+		if (!levelHeader || levelHeader->nVertices > size_ || levelHeader->nFaces > size_) {
+			close();
+			return false;
+		}
+		Level level;
+		level.level = levelHeader->level;
+		level.nVertices = levelHeader->nVertices;
+		level.nFaces = levelHeader->nFaces;
+		level.vertexNormals = (const Vec3f*)reader.read(level.nVertices*sizeof(Vec3f));
+		level.faceNormals = (const Vec3f*)reader.read(level.nFaces*sizeof(Vec3f));
+		level.curvature = (const CurvatureInfo*)reader.read(level.nVertices*sizeof(CurvatureInfo));
+		levels_.push_back(level);
+	}
+	if (!reader.ok()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MeshCache::close() {
+	if (data_) munmap(data_, size_);
+	data_ = 0;
+	size_ = 0;
+	levels_.clear();
+}
+
+bool MeshCache::isOpen() const {
+	return data_ != 0;
+}
+
+void MeshCache::loadProgressive(ProgressiveMesh &progressive) const {
+	progressive.assign(points_, nPoints_, indices_, nFaces_, splits_, nSplits_, corners_, nCorners_, faceCount_);
+}
+
+bool MeshCache::loadLevel(size_t level, Mesh &mesh, VPropHandleT<CurvatureInfo> &curvature) const {
+	for (size_t l = 0; l < levels_.size(); l++) {
+		const Level &cached = levels_[l];
+		if (cached.level != level || cached.nVertices != mesh.n_vertices() || cached.nFaces != mesh.n_faces()) continue;
+		for (size_t v = 0; v < cached.nVertices; v++) {
+			Mesh::VertexHandle vh((int)v);
+			mesh.set_normal(vh, cached.vertexNormals[v]);
+			mesh.property(curvature, vh) = cached.curvature[v];
+		}
+		for (size_t f = 0; f < cached.nFaces; f++) mesh.set_normal(Mesh::FaceHandle((int)f), cached.faceNormals[f]);
+		return true;
+	}
+	return false;
+}
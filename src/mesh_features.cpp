@@ -1,6 +1,12 @@
 #include "mesh_features.h"
+#include <math.h>
+#include <algorithm>
 using namespace OpenMesh;
 
+#ifndef M_PI
+#define M_PI 3.14159265359
+#endif
+
 bool isSilhouette(Mesh &mesh, const Mesh::EdgeHandle &e, Vec3f cameraPos)  {
     // Gather the parts
     Mesh::HalfedgeHandle hh = mesh.halfedge_handle(e,0);
@@ -22,7 +28,7 @@ bool isSilhouette(Mesh &mesh, const Mesh::EdgeHandle &e, Vec3f cameraPos)  {
     return (dot(nr, v) * dot(nl, v) < 0.0f);
 }
 
-bool isSharpEdge(Mesh &mesh, const Mesh::EdgeHandle &e) {
+bool isSharpEdge(Mesh &mesh, const Mesh::EdgeHandle &e, float sharpAngle) {
 	// Gather the parts
     Mesh::HalfedgeHandle hh = mesh.halfedge_handle(e,0);
     // faces
@@ -32,10 +38,146 @@ bool isSharpEdge(Mesh &mesh, const Mesh::EdgeHandle &e) {
     Vec3f nr(mesh.normal(fr));
     Vec3f nl(mesh.normal(fl));
 
-    return (dot(nr, nl) < 0.5f);
+    return (dot(nr, nl) < cosf(sharpAngle*(float)M_PI/180.0f));
 }
 
 bool isFeatureEdge(Mesh &mesh, const Mesh::EdgeHandle &e, Vec3f cameraPos) {
 	return mesh.is_boundary(e) || isSilhouette(mesh,e, cameraPos) || isSharpEdge(mesh,e);
 }
 
+
+// Per-edge data used while building the silhouette hierarchy
+struct SilhouetteEdge {
+    Mesh::EdgeHandle e;
+    Vec3f mid, n[2];
+};
+
+struct MidpointLess {
+    int axis;
+    MidpointLess(int axis) : axis(axis) {}
+    bool operator()(const SilhouetteEdge &a, const SilhouetteEdge &b) const { return a.mid[axis] < b.mid[axis]; }
+};
+
+// Builds the subtree over edges[first, first+count) and returns its index
+static int buildSilhouetteNode(std::vector<SilhouetteEdge> &edges, unsigned int first, unsigned int count, std::vector<SilhouetteNode> &nodes) {
+    const unsigned int leafSize = 16;
+    
+    SilhouetteNode node;
+    node.first = first;
+    node.count = count;
+    node.children[0] = node.children[1] = -1;
+    
+    // bound the midpoints and the face normals
+    node.boxMin = node.boxMax = edges[first].mid;
+    Vec3f sum(0,0,0);
+    for (unsigned int i = first; i < first+count; i++) {
+        node.boxMin.minimize(edges[i].mid);
+        node.boxMax.maximize(edges[i].mid);
+        sum += edges[i].n[0] + edges[i].n[1];
+    }
+    float sumLength = sum.length();
+    if (sumLength < 1e-6f) {
+        node.coneAxis = Vec3f(0,0,1);
+        node.coneAngle = (float)M_PI;
+    } else {
+        node.coneAxis = sum/sumLength;
+        float minCos = 1;
+        for (unsigned int i = first; i < first+count; i++)
+            for (int j = 0; j < 2; j++)
+                minCos = std::min(minCos, dot(node.coneAxis, edges[i].n[j]));
+        node.coneAngle = acosf(std::max(-1.0f, minCos));
+    }
+    
+    int index = (int)nodes.size();
+    nodes.push_back(node);
+    if (count <= leafSize) return index;
+    
+    // split at the median along the longest box axis
+    Vec3f extent = node.boxMax - node.boxMin;
+    int axis = (extent[0] > extent[1]) ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+    unsigned int half = count/2;
+    std::nth_element(edges.begin()+first, edges.begin()+first+half, edges.begin()+first+count, MidpointLess(axis));
+    
+    int left = buildSilhouetteNode(edges, first, half, nodes);
+    int right = buildSilhouetteNode(edges, first+half, count-half, nodes);
+    nodes[index].children[0] = left;
+    nodes[index].children[1] = right;
+    return index;
+}
+
+// True if every face under the node faces the same way for every edge
+// midpoint under it, so none of its edges can be a silhouette.  The box is
+// replaced by its bounding sphere: seen from the eye, directions to points in
+// the sphere are within asin(r/d) of the direction to its center, and the
+// normals are within coneAngle of the axis.
+static bool isSilhouetteFree(const SilhouetteNode &node, const Vec3f &cameraPos) {
+    if (node.coneAngle >= (float)M_PI/2) return false;
+    Vec3f center = (node.boxMin + node.boxMax)*0.5f;
+    float radius = (node.boxMax - node.boxMin).length()*0.5f;
+    Vec3f v = cameraPos - center;
+    float dist = v.length();
+    if (dist <= radius) return false;
+    
+    float viewAngle = acosf(std::max(-1.0f, std::min(1.0f, dot(node.coneAxis, v)/dist)));
+    float spread = node.coneAngle + asinf(radius/dist);
+    return viewAngle + spread < (float)M_PI/2      // all front-facing
+        || viewAngle - spread > (float)M_PI/2;     // all back-facing
+}
+
+void buildFeatureEdgeCache(Mesh &mesh, FeatureEdgeCache &cache) {
+    cache.staticLines.clear();
+    cache.silhouetteCandidates.clear();
+    cache.silhouetteTree.clear();
+    
+    std::vector<SilhouetteEdge> candidates;
+    for (Mesh::EdgeIter it = mesh.edges_begin(); it != mesh.edges_end(); ++it) {
+        Mesh::EdgeHandle e = it.handle();
+        Mesh::HalfedgeHandle hh = mesh.halfedge_handle(e,0);
+        if (mesh.is_boundary(e) || isSharpEdge(mesh, e, cache.sharpAngle)) {
+            cache.staticLines.push_back(mesh.from_vertex_handle(hh).idx());
+            cache.staticLines.push_back(mesh.to_vertex_handle(hh).idx());
+        } else {
+            SilhouetteEdge s;
+            s.e = e;
+            s.mid = (mesh.point(mesh.from_vertex_handle(hh)) + mesh.point(mesh.to_vertex_handle(hh)))/2;
+            s.n[0] = mesh.normal(mesh.face_handle(hh));
+            s.n[1] = mesh.normal(mesh.face_handle(mesh.opposite_halfedge_handle(hh)));
+            candidates.push_back(s);
+        }
+    }
+    
+    if (!candidates.empty()) {
+        cache.silhouetteTree.reserve(candidates.size()/8 + 1);
+        buildSilhouetteNode(candidates, 0, candidates.size(), cache.silhouetteTree);
+    }
+    chainLines(mesh, cache.staticLines, cache.staticPolylines);
+    
+    cache.silhouetteCandidates.reserve(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) cache.silhouetteCandidates.push_back(candidates[i].e);
+    cache.valid = true;
+}
+
+void findSilhouettes(Mesh &mesh, const FeatureEdgeCache &cache, Vec3f cameraPos, std::vector<unsigned int> &lines) {
+    if (cache.silhouetteTree.empty()) return;
+    
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const SilhouetteNode &node = cache.silhouetteTree[stack[--top]];
+        if (isSilhouetteFree(node, cameraPos)) continue;
+        if (node.children[0] >= 0) {
+            stack[top++] = node.children[0];
+            stack[top++] = node.children[1];
+            continue;
+        }
+        for (unsigned int i = node.first; i < node.first+node.count; i++) {
+            Mesh::EdgeHandle e = cache.silhouetteCandidates[i];
+            if (isSilhouette(mesh, e, cameraPos)) {
+                Mesh::HalfedgeHandle hh = mesh.halfedge_handle(e,0);
+                lines.push_back(mesh.from_vertex_handle(hh).idx());
+                lines.push_back(mesh.to_vertex_handle(hh).idx());
+            }
+        }
+    }
+}
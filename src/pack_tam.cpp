@@ -0,0 +1,25 @@
+#include "tam_atlas.h"
+#include <iostream>
+using namespace std;
+
+// Packs the TAM images of a directory into the atlas drawMesh loads
+int main(int argc, char** argv) {
+	string directory = argc > 1 ? argv[1] : "textures";
+	string output = argc > 2 ? argv[2] : directory + "/tam.atlas";
+	if (argc > 3) {
+		cout << "Usage: " << argv[0] << " [texture_directory] [atlas_filename]\n";
+		return 1;
+	}
+
+	TamAtlas atlas;
+	if (!packTamAtlas(directory, atlas)) {
+		cout << "Could not read the TAM images in " << directory << ".\n";
+		return 1;
+	}
+	if (!writeTamAtlas(output, atlas)) {
+		cout << "Could not write " << output << ".\n";
+		return 1;
+	}
+	cout << "Wrote " << output << ": " << TAM_TONES << " tones, " << atlas.levels << " levels from " << atlas.size << 'x' << atlas.size << ".\n";
+	return 0;
+}
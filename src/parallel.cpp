@@ -0,0 +1,82 @@
+#include "parallel.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+using namespace std;
+
+static int threadCount = 0;
+static thread_local bool insideParallelFor = false;
+
+void setNumThreads(int n) {
+    threadCount = n < 0 ? 0 : n;
+}
+
+int numThreads() {
+    if (threadCount > 0) return threadCount;
+    int hw = (int)thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+int parallelChunks(size_t count, size_t minChunk) {
+    if (insideParallelFor || count == 0) return 1;
+    if (minChunk == 0) minChunk = 1;
+    size_t chunks = (count + minChunk - 1) / minChunk;
+    size_t threads = (size_t)numThreads();
+    return (int)(chunks < threads ? chunks : threads);
+}
+
+void parallelFor(size_t begin, size_t end, const ParallelBody &body, size_t minChunk) {
+    if (end <= begin) return;
+    size_t count = end - begin;
+    int chunks = parallelChunks(count, minChunk);
+    if (chunks <= 1) {
+        body(begin, end, 0);
+        return;
+    }
+
+    // chunk c owns [begin + count*c/chunks, begin + count*(c+1)/chunks)
+    vector<thread> workers;
+    workers.reserve(chunks-1);
+    for (int c = 1; c < chunks; c++) {
+        size_t b = begin + count*c/chunks;
+        size_t e = begin + count*(c+1)/chunks;
+        workers.push_back(thread([&body, b, e, c]() {
+            insideParallelFor = true;
+            body(b, e, c);
+        }));
+    }
+
+    // the calling thread takes the first chunk
+    insideParallelFor = true;
+    body(begin, begin + count/chunks, 0);
+    insideParallelFor = false;
+
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+void parallelForDynamic(size_t begin, size_t end, const ParallelBody &body, size_t grain) {
+    if (end <= begin) return;
+    if (grain == 0) grain = 1;
+    int threads = parallelChunks(end - begin, grain);
+    if (threads <= 1) {
+        body(begin, end, 0);
+        return;
+    }
+
+    atomic<size_t> next(begin);
+    auto run = [&](int t) {
+        insideParallelFor = true;
+        for (;;) {
+            size_t b = next.fetch_add(grain);
+            if (b >= end) break;
+            body(b, b + grain < end ? b + grain : end, t);
+        }
+    };
+    vector<thread> workers;
+    workers.reserve(threads-1);
+    for (int t = 1; t < threads; t++) workers.push_back(thread(run, t));
+    run(0);
+    insideParallelFor = false;
+
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+}
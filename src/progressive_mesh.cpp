@@ -0,0 +1,194 @@
+#include "progressive_mesh.h"
+#include "decimate.h"
+#include <algorithm>
+#include <climits>
+using namespace OpenMesh;
+using namespace std;
+
+ProgressiveMesh::ProgressiveMesh() : collapsed_(0) {
+}
+
+void ProgressiveMesh::build(const Mesh &mesh, float basePercentage, bool parallel) {
+	size_t nv = mesh.n_vertices(), nf = mesh.n_faces();
+
+	points_.resize(nv);
+	for (size_t i = 0; i < nv; i++) points_[i] = mesh.point(Mesh::VertexHandle((int)i));
+
+	vector<unsigned int> tri(3*nf);
+	for (size_t f = 0; f < nf; f++) {
+		Mesh::ConstFaceVertexIter cfv_it = mesh.cfv_iter(Mesh::FaceHandle((int)f));
+		for (int k = 0; k < 3; k++, ++cfv_it) tri[3*f+k] = cfv_it.handle().idx();
+	}
+
+	// decimate a copy and keep only the collapse sequence
+	vector<CollapseRecord> records;
+	{
+		Mesh coarse = mesh;
+		Decimator decimator(coarse);
+		decimator.recordCollapses(&records);
+		decimator.simplify(basePercentage, parallel);
+	}
+
+	// replay the collapses on the face list to find which faces each one
+	// removes and which corners it redirects
+	vector< vector<unsigned int> > vertexFaces(nv);
+	for (size_t f = 0; f < nf; f++)
+		for (int k = 0; k < 3; k++) vertexFaces[tri[3*f+k]].push_back((unsigned int)f);
+
+	vector<int> removedAt(nf, INT_MAX);
+	vector<Mesh::Point> position(points_);
+	splits_.resize(records.size());
+	corners_.clear();
+	for (size_t i = 0; i < records.size(); i++) {
+		unsigned int from = records[i].from, to = records[i].to;
+		VertexSplit &split = splits_[i];
+		split.from = from;
+		split.to = to;
+		split.toFine = position[to];
+		split.toCoarse = records[i].position;
+		split.firstCorner = (unsigned int)corners_.size();
+		position[to] = records[i].position;
+
+		for (size_t j = 0; j < vertexFaces[from].size(); j++) {
+			unsigned int f = vertexFaces[from][j];
+			if (removedAt[f] != INT_MAX) continue;
+			unsigned int *t = &tri[3*f];
+			if (t[0] == to || t[1] == to || t[2] == to) {
+				removedAt[f] = (int)i;
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				if (t[k] != from) continue;
+				t[k] = to;
+				corners_.push_back(3*f+k);
+			}
+			vertexFaces[to].push_back(f);
+		}
+		vector<unsigned int>().swap(vertexFaces[from]);
+		split.nCorners = (unsigned int)corners_.size() - split.firstCorner;
+	}
+
+	// order faces by how long they live, so the live faces of every
+	// level are a prefix
+	vector<unsigned int> order(nf);
+	for (size_t f = 0; f < nf; f++) order[f] = (unsigned int)f;
+	stable_sort(order.begin(), order.end(),
+				[&](unsigned int a, unsigned int b) { return removedAt[a] > removedAt[b]; });
+	vector<unsigned int> slot(nf);
+	indices_.resize(3*nf);
+	for (size_t s = 0; s < nf; s++) {
+		slot[order[s]] = (unsigned int)s;
+		for (int k = 0; k < 3; k++) indices_[3*s+k] = tri[3*order[s]+k];
+	}
+	for (size_t c = 0; c < corners_.size(); c++)
+		corners_[c] = 3*slot[corners_[c]/3] + corners_[c]%3;
+
+	faceCount_.assign(records.size()+1, 0);
+	for (size_t f = 0; f < nf; f++) {
+		int last = removedAt[f] == INT_MAX ? (int)records.size() : removedAt[f];
+		faceCount_[last]++;
+	}
+	for (int i = (int)records.size()-1; i >= 0; i--) faceCount_[i] += faceCount_[i+1];
+
+	// tri and position now hold the coarsest level; split back up
+	points_ = position;
+	collapsed_ = records.size();
+	setNumVertices(nv);
+}
+
+size_t ProgressiveMesh::maxVertices() const {
+	return points_.size();
+}
+
+size_t ProgressiveMesh::minVertices() const {
+	return points_.size() - splits_.size();
+}
+
+size_t ProgressiveMesh::numVertices() const {
+	return points_.size() - collapsed_;
+}
+
+void ProgressiveMesh::setNumVertices(size_t n) {
+	n = max(minVertices(), min(maxVertices(), n));
+	size_t target = maxVertices() - n;
+
+	while (collapsed_ < target) {
+		const VertexSplit &split = splits_[collapsed_++];
+		for (unsigned int c = 0; c < split.nCorners; c++)
+			indices_[corners_[split.firstCorner + c]] = split.to;
+		points_[split.to] = split.toCoarse;
+	}
+	while (collapsed_ > target) {
+		const VertexSplit &split = splits_[--collapsed_];
+		for (unsigned int c = 0; c < split.nCorners; c++)
+			indices_[corners_[split.firstCorner + c]] = split.from;
+		points_[split.to] = split.toFine;
+	}
+}
+
+size_t ProgressiveMesh::numFaces() const {
+	return faceCount_.empty() ? 0 : faceCount_[collapsed_];
+}
+
+const vector<unsigned int>& ProgressiveMesh::indices() const {
+	return indices_;
+}
+
+const vector<Mesh::Point>& ProgressiveMesh::points() const {
+	return points_;
+}
+
+void ProgressiveMesh::extract(Mesh &mesh, vector<unsigned int> *vertexIds) const {
+	mesh.clear();
+	mesh.reserve(numVertices(), 3*numVertices(), numFaces());
+	if (vertexIds) vertexIds->clear();
+
+	vector<int> vertex(points_.size(), -1);
+	for (size_t i = 0; i < 3*numFaces(); i += 3) {
+		Mesh::VertexHandle vh[3];
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = indices_[i+k];
+			if (vertex[v] < 0) {
+				vertex[v] = mesh.add_vertex(points_[v]).idx();
+				if (vertexIds) vertexIds->push_back(v);
+			}
+			vh[k] = Mesh::VertexHandle(vertex[v]);
+		}
+		mesh.add_face(vh[0], vh[1], vh[2]);
+	}
+}
+
+void ProgressiveMesh::ancestors(size_t n, vector<unsigned int> &ancestor) const {
+	n = max(minVertices(), min(maxVertices(), n));
+	size_t collapses = maxVertices() - n;
+
+	ancestor.resize(points_.size());
+	for (size_t v = 0; v < ancestor.size(); v++) ancestor[v] = (unsigned int)v;
+	// walking backwards, the survivor of each collapse already knows where
+	// it ends up
+	for (size_t i = collapses; i-- > 0; )
+		ancestor[splits_[i].from] = ancestor[splits_[i].to];
+}
+
+const vector<VertexSplit>& ProgressiveMesh::splits() const {
+	return splits_;
+}
+
+const vector<unsigned int>& ProgressiveMesh::corners() const {
+	return corners_;
+}
+
+const vector<unsigned int>& ProgressiveMesh::faceCounts() const {
+	return faceCount_;
+}
+
+void ProgressiveMesh::assign(const Mesh::Point *points, size_t nPoints, const unsigned int *indices, size_t nFaces,
+							 const VertexSplit *splits, size_t nSplits, const unsigned int *corners, size_t nCorners,
+							 const unsigned int *faceCount) {
+	points_.assign(points, points + nPoints);
+	indices_.assign(indices, indices + 3*nFaces);
+	splits_.assign(splits, splits + nSplits);
+	corners_.assign(corners, corners + nCorners);
+	faceCount_.assign(faceCount, faceCount + nSplits + 1);
+	collapsed_ = 0;
+}
@@ -0,0 +1,195 @@
+#include "rasterizer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <math.h>
+
+#if defined(__AVX2__)
+#define RASTER_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace OpenMesh;
+using namespace std;
+
+static const int TILE_SIZE = 64;
+
+void cameraProjection(const Camera &camera, ScreenProjection &projection) {
+	projection.viewport[0] = 0;
+	projection.viewport[1] = 0;
+	projection.viewport[2] = camera.width;
+	projection.viewport[3] = camera.height;
+
+	// gluPerspective
+	double aspect = (double)camera.width / camera.height;
+	double f = 1/tan(camera.fovy*M_PI/360);
+	double n = camera.zNear, fa = camera.zFar;
+	double P[16] = { f/aspect, 0, 0, 0,
+					 0, f, 0, 0,
+					 0, 0, (fa+n)/(n-fa), -1,
+					 0, 0, 2*fa*n/(n-fa), 0 };
+
+	// gluLookAt
+	Vec3f F = (camera.center - camera.eye).normalized();
+	Vec3f s = (F % camera.up.normalized()).normalized();
+	Vec3f u = s % F;
+	const Vec3f &e = camera.eye;
+	double M[16] = { s[0], u[0], -F[0], 0,
+					 s[1], u[1], -F[1], 0,
+					 s[2], u[2], -F[2], 0,
+					 -dot(s,e), -dot(u,e), dot(F,e), 1 };
+
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++) {
+			double sum = 0;
+			for (int k = 0; k < 4; k++) sum += P[4*k+r]*M[4*c+k];
+			projection.matrix[4*c+r] = sum;
+		}
+}
+
+// One triangle clipped to one tile: edge functions e_i = a_i*x + b_i*y + c_i
+// are non-negative inside, depth is az*x + bz*y + cz
+struct TriangleSetup {
+	float a[3], b[3], c[3];
+	float az, bz, cz;
+	int xMin, xMax, yMin, yMax;   // inclusive pixel bounds
+};
+
+static bool setupTriangle(const Vec3f &p0, const Vec3f &p1, const Vec3f &p2, TriangleSetup &t) {
+	const Vec3f *p[3] = { &p0, &p1, &p2 };
+	double area = ((double)p1[0]-p0[0])*((double)p2[1]-p0[1]) - ((double)p2[0]-p0[0])*((double)p1[1]-p0[1]);
+	if (fabs(area) < 1e-12) return false;
+	double sign = area > 0 ? 1 : -1;
+
+	// edge i is opposite vertex i
+	double az = 0, bz = 0, cz = 0;
+	for (int i = 0; i < 3; i++) {
+		const Vec3f &pj = *p[(i+1)%3], &pk = *p[(i+2)%3];
+		double a = sign*((double)pj[1] - pk[1]);
+		double b = sign*((double)pk[0] - pj[0]);
+		double c = sign*((double)pj[0]*pk[1] - (double)pk[0]*pj[1]);
+		t.a[i] = (float)a; t.b[i] = (float)b; t.c[i] = (float)c;
+		double z = (*p[i])[2]/fabs(area);
+		az += a*z; bz += b*z; cz += c*z;
+	}
+	t.az = (float)az; t.bz = (float)bz; t.cz = (float)cz;
+
+	t.xMin = (int)floor(min(p0[0], min(p1[0], p2[0])));
+	t.xMax = (int)ceil(max(p0[0], max(p1[0], p2[0])));
+	t.yMin = (int)floor(min(p0[1], min(p1[1], p2[1])));
+	t.yMax = (int)ceil(max(p0[1], max(p1[1], p2[1])));
+	return true;
+}
+
+// Rasterizes t into the pixels [x0,x1) x [y0,y1) of the depth image
+static void rasterizeTile(const TriangleSetup &t, int x0, int x1, int y0, int y1, int width, float *depth) {
+	x0 = max(x0, t.xMin); x1 = min(x1, t.xMax + 1);
+	y0 = max(y0, t.yMin); y1 = min(y1, t.yMax + 1);
+	for (int y = y0; y < y1; y++) {
+		float py = y + 0.5f;
+		float r0 = t.b[0]*py + t.c[0], r1 = t.b[1]*py + t.c[1], r2 = t.b[2]*py + t.c[2];
+		float rz = t.bz*py + t.cz;
+		float *row = depth + (size_t)y*width;
+		int x = x0;
+#ifdef RASTER_AVX2
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 a0 = _mm256_set1_ps(t.a[0]), a1 = _mm256_set1_ps(t.a[1]), a2 = _mm256_set1_ps(t.a[2]);
+		const __m256 az = _mm256_set1_ps(t.az);
+		const __m256 vr0 = _mm256_set1_ps(r0), vr1 = _mm256_set1_ps(r1), vr2 = _mm256_set1_ps(r2);
+		const __m256 vrz = _mm256_set1_ps(rz);
+		const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		for (; x + 8 <= x1; x += 8) {
+			__m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+			__m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), vr0);
+			__m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), vr1);
+			__m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), vr2);
+			__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+														_mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+										  _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+			if (_mm256_movemask_ps(inside) == 0) continue;
+			__m256 z = _mm256_add_ps(_mm256_mul_ps(az, px), vrz);
+			__m256 old = _mm256_loadu_ps(row + x);
+			__m256 closer = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(old, z, closer));
+		}
+#endif
+		for (; x < x1; x++) {
+			float px = x + 0.5f;
+			if (t.a[0]*px + r0 < 0 || t.a[1]*px + r1 < 0 || t.a[2]*px + r2 < 0) continue;
+			float z = t.az*px + rz;
+			if (z < row[x]) row[x] = z;
+		}
+	}
+}
+
+void rasterizeDepth(const Vec3f *points, size_t nPoints, const vector<unsigned int> &triangles, const ScreenProjection &projection, DepthImage &image) {
+	image.x = image.y = 0;
+	image.width = projection.viewport[2];
+	image.height = projection.viewport[3];
+	image.depth.assign((size_t)image.width*image.height, 1.0f);
+	if (image.depth.empty()) return;
+
+	// Rasterize in viewport-relative pixels
+	ScreenProjection local = projection;
+	local.viewport[0] = local.viewport[1] = 0;
+	vector<Vec3f> screen(nPoints);
+	parallelFor(0, nPoints, [&](size_t begin, size_t end, int) {
+		projectPoints(local, points + begin, end - begin, &screen[begin]);
+	}, 4096);
+
+	// Bin triangles into the tiles their bounding boxes touch, one set of
+	// bins per chunk so binning needs no locks
+	int tilesX = (image.width + TILE_SIZE - 1)/TILE_SIZE;
+	int tilesY = (image.height + TILE_SIZE - 1)/TILE_SIZE;
+	size_t nt = triangles.size()/3;
+	const size_t minChunk = 4096;
+	vector< vector< vector<unsigned int> > > bins(parallelChunks(nt, minChunk), vector< vector<unsigned int> >(tilesX*tilesY));
+	parallelFor(0, nt, [&](size_t begin, size_t end, int chunk) {
+		vector< vector<unsigned int> > &chunkBins = bins[chunk];
+		for (size_t t = begin; t < end; t++) {
+			const Vec3f &p0 = screen[triangles[3*t]], &p1 = screen[triangles[3*t+1]], &p2 = screen[triangles[3*t+2]];
+			// behind the near plane or beyond the far plane
+			if (p0[2] < 0 || p1[2] < 0 || p2[2] < 0 || p0[2] > 1 || p1[2] > 1 || p2[2] > 1) continue;
+			int x0 = (int)floor(min(p0[0], min(p1[0], p2[0]))) / TILE_SIZE;
+			int x1 = (int)ceil(max(p0[0], max(p1[0], p2[0]))) / TILE_SIZE;
+			int y0 = (int)floor(min(p0[1], min(p1[1], p2[1]))) / TILE_SIZE;
+			int y1 = (int)ceil(max(p0[1], max(p1[1], p2[1]))) / TILE_SIZE;
+			if (x1 < 0 || y1 < 0 || x0 >= tilesX || y0 >= tilesY) continue;
+			x0 = max(x0, 0); y0 = max(y0, 0);
+			x1 = min(x1, tilesX-1); y1 = min(y1, tilesY-1);
+			for (int ty = y0; ty <= y1; ty++)
+				for (int tx = x0; tx <= x1; tx++)
+					chunkBins[ty*tilesX + tx].push_back((unsigned int)t);
+		}
+	}, minChunk);
+
+	// Each tile owns its pixels, so tiles can be filled concurrently
+	float *depth = &image.depth[0];
+	parallelFor(0, (size_t)tilesX*tilesY, [&](size_t begin, size_t end, int) {
+		for (size_t tile = begin; tile < end; tile++) {
+			int x0 = (int)(tile % tilesX)*TILE_SIZE, y0 = (int)(tile / tilesX)*TILE_SIZE;
+			int x1 = min(x0 + TILE_SIZE, image.width), y1 = min(y0 + TILE_SIZE, image.height);
+			for (size_t c = 0; c < bins.size(); c++) {
+				const vector<unsigned int> &bin = bins[c][tile];
+				for (size_t i = 0; i < bin.size(); i++) {
+					const unsigned int *tri = &triangles[3*bin[i]];
+					TriangleSetup setup;
+					if (setupTriangle(screen[tri[0]], screen[tri[1]], screen[tri[2]], setup))
+						rasterizeTile(setup, x0, x1, y0, y1, image.width, depth);
+				}
+			}
+		}
+	}, 1);
+
+	image.x = projection.viewport[0];
+	image.y = projection.viewport[1];
+}
+
+void rasterizeDepth(const Mesh &mesh, const ScreenProjection &projection, DepthImage &image) {
+	vector<unsigned int> triangles(3*mesh.n_faces());
+	for (Mesh::ConstFaceIter f_it = mesh.faces_begin(); f_it != mesh.faces_end(); ++f_it) {
+		size_t f = f_it.handle().idx();
+		Mesh::ConstFaceVertexIter cfv_it = mesh.cfv_iter(f_it.handle());
+		for (int k = 0; k < 3; k++, ++cfv_it) triangles[3*f+k] = cfv_it.handle().idx();
+	}
+	rasterizeDepth(mesh.points(), mesh.n_vertices(), triangles, projection, image);
+}
@@ -0,0 +1,121 @@
+#include "svg_writer.h"
+#include <math.h>
+#include <string.h>
+using namespace OpenMesh;
+using namespace std;
+
+static const size_t BUFFER_SIZE = 1 << 20;
+
+SvgWriter::SvgWriter() : file_(0), buffer_(BUFFER_SIZE), used_(0), height_(0), inPath_(false), lastX_(0), lastY_(0) {
+}
+
+SvgWriter::~SvgWriter() {
+	close();
+}
+
+bool SvgWriter::open(const string &filename, int width, int height) {
+	close();
+	file_ = fopen(filename.c_str(), "wb");
+	if (!file_) return false;
+	height_ = height;
+	char header[256];
+	snprintf(header, sizeof(header), "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+			 "<svg width=\"5in\" height=\"5in\" viewBox=\"0 0 %d %d\">\n"
+			 "<g stroke=\"black\" fill=\"black\">\n", width, height);
+	put(header);
+	return true;
+}
+
+void SvgWriter::beginPath() {
+	if (inPath_) endPath();
+	put("<path d=\"");
+	inPath_ = true;
+	// the first moveto of a path is absolute even in lower case
+	lastX_ = lastY_ = 0;
+}
+
+void SvgWriter::endPath() {
+	if (!inPath_) return;
+	put("\" fill=\"none\" stroke-width=\"1\" />\n");
+	inPath_ = false;
+}
+
+void SvgWriter::polyline(const Vec3f *points, size_t n) {
+	if (n < 2 || !file_) return;
+	bool single = !inPath_;
+	if (single) beginPath();
+	for (size_t i = 0; i < n; i++) {
+		long long x = llround(points[i][0]*100.0), y = llround((height_ - points[i][1])*100.0);
+		if (i < 2) {
+			reserve(1);
+			buffer_[used_++] = i == 0 ? 'm' : 'l';
+		}
+		putFixed(x - lastX_, i >= 2);
+		putFixed(y - lastY_, true);
+		lastX_ = x;
+		lastY_ = y;
+	}
+	if (single) endPath();
+}
+
+void SvgWriter::close() {
+	if (!file_) return;
+	endPath();
+	put("</g>\n</svg>\n");
+	flush();
+	fclose(file_);
+	file_ = 0;
+}
+
+void SvgWriter::reserve(size_t n) {
+	if (used_ + n > buffer_.size()) flush();
+}
+
+void SvgWriter::flush() {
+	if (file_ && used_) fwrite(&buffer_[0], 1, used_, file_);
+	used_ = 0;
+}
+
+void SvgWriter::put(const char *s) {
+	size_t n = strlen(s);
+	reserve(n);
+	if (n > buffer_.size()) {
+		fwrite(s, 1, n, file_);
+		return;
+	}
+	memcpy(&buffer_[used_], s, n);
+	used_ += n;
+}
+
+// Writes v/100 with at most two decimals and no trailing zeros.  A
+// separator is only needed when the number does not start with '-'.
+void SvgWriter::putFixed(long long hundredths, bool separate) {
+	reserve(32);
+	char *out = &buffer_[used_];
+	char *p = out;
+	unsigned long long v;
+	if (hundredths < 0) {
+		*p++ = '-';
+		v = 0ULL - (unsigned long long)hundredths;
+	}
+	else {
+		if (separate) *p++ = ' ';
+		v = (unsigned long long)hundredths;
+	}
+
+	unsigned long long whole = v / 100;
+	unsigned int frac = (unsigned int)(v % 100);
+	char digits[24];
+	int nd = 0;
+	do {
+		digits[nd++] = (char)('0' + whole % 10);
+		whole /= 10;
+	} while (whole);
+	while (nd) *p++ = digits[--nd];
+	if (frac) {
+		*p++ = '.';
+		*p++ = (char)('0' + frac / 10);
+		if (frac % 10) *p++ = (char)('0' + frac % 10);
+	}
+	used_ += p - out;
+}
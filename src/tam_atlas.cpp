@@ -0,0 +1,95 @@
+#include "tam_atlas.h"
+#include <SFML/Graphics.hpp>
+#include <cstdio>
+#include <iostream>
+#include <string.h>
+#include <stdint.h>
+using namespace std;
+
+static const char ATLAS_MAGIC[8] = { 'T','A','M','A','T','L','A','S' };
+
+struct AtlasHeader {
+	char magic[8];
+	uint32_t size, levels;
+};
+
+// Offset in bytes of a level within one texture's chain
+static size_t levelOffset(int size, int l) {
+	size_t offset = 0;
+	for (int i = 0; i < l; i++) offset += 4*(size_t)(size >> i)*(size >> i);
+	return offset;
+}
+
+const unsigned char* TamAtlas::level(int texture, int l) const {
+	return &pixels[texture*levelOffset(size, levels) + levelOffset(size, l)];
+}
+
+unsigned char* TamAtlas::level(int texture, int l) {
+	return &pixels[texture*levelOffset(size, levels) + levelOffset(size, l)];
+}
+
+bool packTamAtlas(const string &directory, TamAtlas &atlas) {
+	atlas.size = 0;
+	atlas.levels = TAM_LEVELS;
+	for (int tone = 0; tone < TAM_TONES; tone++) {
+		int texture = tone / 3, channel = tone % 3;
+		for (int l = 0; l < TAM_LEVELS; l++) {
+			char name[64];
+			snprintf(name, sizeof(name), "/tam%d%d.bmp", tone, TAM_LEVELS-1-l);
+			sf::Image image;
+			if (!image.loadFromFile(directory + name)) return false;
+			sf::Vector2u imageSize = image.getSize();
+			if (atlas.size == 0) {
+				atlas.size = imageSize.x;
+				atlas.pixels.assign(2*levelOffset(atlas.size, atlas.levels), 255);
+			}
+			int size = atlas.size >> l;
+			if ((int)imageSize.x != size || (int)imageSize.y != size) {
+				cerr << directory << name << " is not " << size << 'x' << size << endl;
+				return false;
+			}
+
+			// grayscale of the image into this tone's channel
+			const unsigned char *in = image.getPixelsPtr();
+			unsigned char *out = atlas.level(texture, l);
+			for (size_t i = 0; i < (size_t)size*size; i++)
+				out[4*i + channel] = (unsigned char)((in[4*i] + in[4*i+1] + in[4*i+2])/3);
+		}
+	}
+	return true;
+}
+
+bool writeTamAtlas(const string &filename, const TamAtlas &atlas) {
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file) return false;
+	AtlasHeader header;
+	memcpy(header.magic, ATLAS_MAGIC, sizeof(header.magic));
+	header.size = atlas.size;
+	header.levels = atlas.levels;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			  fwrite(&atlas.pixels[0], 1, atlas.pixels.size(), file) == atlas.pixels.size();
+	return fclose(file) == 0 && ok;
+}
+
+bool readTamAtlas(const string &filename, TamAtlas &atlas) {
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file) return false;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	// the header says how much to expect; all levels then come in one read
+	AtlasHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+			  memcmp(header.magic, ATLAS_MAGIC, sizeof(ATLAS_MAGIC)) == 0 && header.size > 0 && header.size <= 65536 &&
+			  header.levels > 0 && header.levels <= 17 && (header.size >> (header.levels-1)) > 0 &&
+			  (size_t)length == sizeof(header) + 2*levelOffset(header.size, header.levels);
+	if (ok) {
+		atlas.size = header.size;
+		atlas.levels = header.levels;
+		atlas.pixels.resize(2*levelOffset(atlas.size, atlas.levels));
+		ok = fread(&atlas.pixels[0], 1, atlas.pixels.size(), file) == atlas.pixels.size();
+	}
+	fclose(file);
+	return ok;
+}
@@ -0,0 +1,140 @@
+#include "tam_generator.h"
+#include "parallel.h"
+#include <algorithm>
+#include <math.h>
+#include <random>
+using namespace std;
+
+TamParameters::TamParameters() : size(256), crossTone(3), strokeWidth(1.5f), minLength(0.25f), maxLength(0.5f),
+								 angleJitter(0.05f), candidates(64), seed(1) {
+	// close to the darkness of the shipped TAM images
+	const float defaultTones[TAM_TONES] = { 0.08f, 0.16f, 0.25f, 0.35f, 0.48f, 0.8f };
+	for (int t = 0; t < TAM_TONES; t++) tones[t] = defaultTones[t];
+}
+
+// A straight stroke in texture coordinates; textures wrap around
+struct TamStroke {
+	float u, v;          // center
+	float dx, dy;        // half of the stroke as a vector
+};
+
+// Calls f(pixel, coverage) for the pixels of an image of edge size that
+// the stroke covers, with antialiased coverage in (0,1]
+template <class F>
+static void forStrokePixels(const TamStroke &stroke, int size, float width, F f) {
+	float cx = stroke.u*size, cy = stroke.v*size;
+	float dx = stroke.dx*size, dy = stroke.dy*size;
+	float ax = cx - dx, ay = cy - dy;
+	float len2 = 4*(dx*dx + dy*dy);
+	float reach = width/2 + 0.5f;
+	int x0 = (int)floor(min(cx - dx, cx + dx) - reach), x1 = (int)ceil(max(cx - dx, cx + dx) + reach);
+	int y0 = (int)floor(min(cy - dy, cy + dy) - reach), y1 = (int)ceil(max(cy - dy, cy + dy) + reach);
+	for (int y = y0; y <= y1; y++) {
+		int wy = ((y % size) + size) % size;
+		for (int x = x0; x <= x1; x++) {
+			// distance from the pixel center to the segment
+			float px = x + 0.5f - ax, py = y + 0.5f - ay;
+			float t = len2 > 0 ? max(0.0f, min(1.0f, (px*2*dx + py*2*dy)/len2)) : 0;
+			float ex = px - t*2*dx, ey = py - t*2*dy;
+			float coverage = reach - sqrt(ex*ex + ey*ey);
+			if (coverage <= 0) continue;
+			int wx = ((x % size) + size) % size;
+			f((size_t)wy*size + wx, min(coverage, 1.0f));
+		}
+	}
+}
+
+// Darkness of every level, coarsest first, with running sums
+struct TamLevels {
+	vector<int> size;
+	vector< vector<float> > darkness;
+	vector<double> total;
+
+	float mean(int l) const { return (float)(total[l]/((double)size[l]*size[l])); }
+};
+
+// Tone the stroke would add to levels first.. and the ink it would use
+static void scoreStroke(const TamLevels &levels, int first, const TamStroke &stroke, float width, double &added, double &ink) {
+	added = ink = 0;
+	for (size_t l = first; l < levels.size.size(); l++) {
+		const vector<float> &darkness = levels.darkness[l];
+		forStrokePixels(stroke, levels.size[l], width, [&](size_t i, float c) {
+			added += max(darkness[i], c) - darkness[i];
+			ink += c;
+		});
+	}
+}
+
+static void addStroke(TamLevels &levels, int first, const TamStroke &stroke, float width) {
+	for (size_t l = first; l < levels.size.size(); l++) {
+		vector<float> &darkness = levels.darkness[l];
+		double &total = levels.total[l];
+		forStrokePixels(stroke, levels.size[l], width, [&](size_t i, float c) {
+			if (c <= darkness[i]) return;
+			total += c - darkness[i];
+			darkness[i] = c;
+		});
+	}
+}
+
+void generateTam(const TamParameters &parameters, TamAtlas &atlas) {
+	int nLevels = TAM_LEVELS;
+	atlas.size = max(parameters.size, 1 << (nLevels-1));
+	atlas.levels = nLevels;
+	TamLevels levels;
+	size_t bytes = 0;
+	for (int l = 0; l < nLevels; l++) {
+		int size = atlas.size >> (nLevels-1-l);
+		levels.size.push_back(size);
+		levels.darkness.push_back(vector<float>((size_t)size*size, 0.0f));
+		levels.total.push_back(0);
+		bytes += 4*(size_t)size*size;
+	}
+	atlas.pixels.assign(2*bytes, 255);
+
+	// candidates are drawn serially, so the result does not depend on the
+	// number of threads
+	mt19937 random(parameters.seed);
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+	int nCandidates = max(1, parameters.candidates);
+	float maxLength = min(parameters.maxLength, 0.9f), minLength = min(parameters.minLength, maxLength);
+	vector<TamStroke> candidates(nCandidates);
+	vector<double> score(nCandidates), added(nCandidates);
+
+	for (int tone = 0; tone < TAM_TONES; tone++) {
+		// light tones hatch along u, dark tones add strokes along v
+		float direction = tone >= parameters.crossTone ? (float)M_PI/2 : 0;
+		for (int l = 0; l < nLevels; l++) {
+			while (levels.mean(l) < parameters.tones[tone]) {
+				for (int c = 0; c < nCandidates; c++) {
+					float length = minLength + (maxLength - minLength)*unit(random);
+					float angle = direction + parameters.angleJitter*(2*unit(random) - 1);
+					TamStroke &stroke = candidates[c];
+					stroke.u = unit(random);
+					stroke.v = unit(random);
+					stroke.dx = length/2*cos(angle);
+					stroke.dy = length/2*sin(angle);
+				}
+				parallelFor(0, nCandidates, [&](size_t begin, size_t end, int) {
+					for (size_t c = begin; c < end; c++) {
+						double ink;
+						scoreStroke(levels, l, candidates[c], parameters.strokeWidth, added[c], ink);
+						score[c] = ink > 0 ? added[c]/ink : 0;
+					}
+				}, 8);
+				int best = (int)(max_element(score.begin(), score.end()) - score.begin());
+				// the levels are saturated, the tone cannot be reached
+				if (added[best] <= 1e-6) break;
+				addStroke(levels, l, candidates[best], parameters.strokeWidth);
+			}
+		}
+
+		// tone t goes to channel t%3 of texture t/3; atlas level 0 is the largest
+		for (int l = 0; l < nLevels; l++) {
+			unsigned char *out = atlas.level(tone/3, nLevels-1-l);
+			const vector<float> &darkness = levels.darkness[l];
+			for (size_t i = 0; i < darkness.size(); i++)
+				out[4*i + tone%3] = (unsigned char)floor(255*(1 - darkness[i]) + 0.5f);
+		}
+	}
+}
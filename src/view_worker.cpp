@@ -0,0 +1,97 @@
+#include "view_worker.h"
+#include <algorithm>
+using namespace OpenMesh;
+using namespace std;
+
+void computeViewState(const Mesh &mesh, const ViewCurvatureCache &cache, const ViewRequest &request, ViewState &state,
+                      const AdaptiveContourMap *adaptive, AdaptiveContourScratch *scratch) {
+    state.camPos = request.camPos;
+    if (request.adaptive && adaptive && adaptive->valid && scratch) {
+        selectContourFaces(*adaptive, cache, request.camPos, *scratch);
+        evaluateViewCurvature(cache, request.camPos, scratch->vertices, scratch->faces, state.field);
+        extractSuggestiveContours(mesh, cache, request.camPos, state.field, request.angleThresh, request.gradThresh, scratch->faces, state.contours);
+    } else {
+        evaluateViewCurvature(cache, request.camPos, state.field);
+        extractSuggestiveContours(mesh, cache, request.camPos, state.field, request.angleThresh, request.gradThresh, state.contours);
+    }
+    chainContours(state.contours, state.contourLines);
+}
+
+ViewWorker::ViewWorker(const Mesh &mesh, const ViewCurvatureCache &cache) :
+	mesh_(mesh),
+	cache_(cache),
+	adaptive_(0),
+	hasPending_(false),
+	fresh_(false),
+	quit_(false),
+	front_(0),
+	ready_(1),
+	back_(2) {
+}
+
+ViewWorker::~ViewWorker() {
+	stop();
+}
+
+void ViewWorker::start() {
+	if (thread_.joinable()) return;
+	quit_ = false;
+	thread_ = thread(&ViewWorker::run, this);
+}
+
+void ViewWorker::stop() {
+	if (!thread_.joinable()) return;
+	{
+		lock_guard<mutex> lock(mutex_);
+		quit_ = true;
+	}
+	wake_.notify_one();
+	thread_.join();
+}
+
+void ViewWorker::setAdaptiveMap(const AdaptiveContourMap *map) {
+	adaptive_ = map;
+}
+
+void ViewWorker::request(const ViewRequest &request) {
+	{
+		lock_guard<mutex> lock(mutex_);
+		pending_ = request;
+		hasPending_ = true;
+	}
+	wake_.notify_one();
+}
+
+bool ViewWorker::acquire() {
+	lock_guard<mutex> lock(mutex_);
+	if (!fresh_) return false;
+	swap(front_, ready_);
+	fresh_ = false;
+	return true;
+}
+
+const ViewState& ViewWorker::front() const {
+	return buffers_[front_];
+}
+
+void ViewWorker::run() {
+	for (;;) {
+		ViewRequest request;
+		{
+			unique_lock<mutex> lock(mutex_);
+			while (!hasPending_ && !quit_) wake_.wait(lock);
+			if (quit_) return;
+			request = pending_;
+			hasPending_ = false;
+		}
+		
+		// back_ belongs to this thread until it is swapped below
+		computeViewState(mesh_, cache_, request, buffers_[back_], adaptive_, &scratch_);
+		
+		{
+			lock_guard<mutex> lock(mutex_);
+			swap(back_, ready_);
+			fresh_ = true;
+		}
+	}
+}